@@ -47,10 +47,17 @@ struct DobozCodec
 {
 	doboz::Compressor compressor;
 	doboz::Decompressor decompressor;
+	const char* name;
+
+	DobozCodec(doboz::CompressionLevel level, const char* name)
+		: compressor(level),
+		  name(name)
+	{
+	}
 
 	const char* getName()
 	{
-		return "Doboz";
+		return name;
 	}
 	
 	size_t getMaxCompressedSize()
@@ -339,6 +346,47 @@ void benchmarkCodec(Codec& codec)
 	cleanup();
 }
 
+// Measures the speed of the compressibility estimation with blocks of the specified size (the whole file if zero)
+void benchmarkEstimation(size_t blockSize)
+{
+	if (blockSize == 0 || blockSize > originalSize)
+	{
+		blockSize = originalSize;
+		cout << "Estimating the compression ratio of the whole file (multiple times)..." << endl;
+	}
+	else
+	{
+		cout << "Estimating the compression ratio of " << blockSize / KILOBYTE << " KB blocks (multiple times)..." << endl;
+	}
+
+	doboz::Compressor compressor;
+	size_t blockCount = originalSize / blockSize;
+
+	Timer timer;
+
+	const int repeatCount = 10;
+	double estimationTime = FLT_MAX;
+	double estimatedRatio = 0.0;
+
+	for (int i = 0; i < repeatCount; ++i)
+	{
+		timer.reset();
+		double ratioSum = 0.0;
+
+		for (size_t j = 0; j < blockCount; ++j)
+		{
+			ratioSum += compressor.estimate(originalBuffer + j * blockSize, blockSize);
+		}
+
+		estimationTime = min(estimationTime, timer.query());
+		estimatedRatio = ratioSum / static_cast<double>(blockCount);
+	}
+
+	double mbps = static_cast<double>(blockCount * blockSize) / MEGABYTE / estimationTime;
+	cout << "Estimation speed: " << mbps << " MB/s" << endl;
+	cout << "Estimated compression ratio: " << estimatedRatio * 100.0 << "%" << endl;
+}
+
 int main(int argc, char* argv[])
 {
 	cout << "Doboz Data Compression Library - BENCHMARK" << endl;
@@ -359,8 +407,21 @@ int main(int argc, char* argv[])
 
 	// Doboz
 	cout << endl;
-	DobozCodec dobozCodec;
+	DobozCodec dobozCodec(doboz::COMPRESSION_LEVEL_DEFAULT, "Doboz");
 	benchmarkCodec(dobozCodec);
+
+	// Doboz with the fast decompression level
+	cout << endl;
+	DobozCodec dobozFastDecompressionCodec(doboz::COMPRESSION_LEVEL_FAST_DECOMPRESSION, "Doboz (fast decompression)");
+	benchmarkCodec(dobozFastDecompressionCodec);
+
+	// Doboz compressibility estimation
+	const size_t estimationBlockSizes[] = {4 * KILOBYTE, 64 * KILOBYTE, 0};
+	for (size_t i = 0; i < sizeof(estimationBlockSizes) / sizeof(estimationBlockSizes[0]); ++i)
+	{
+		cout << endl;
+		benchmarkEstimation(estimationBlockSizes[i]);
+	}
 	
 	// QuickLZ
 	cout << endl;
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <cstddef>
 #include <climits>
 #include <cassert>
 
@@ -30,9 +31,19 @@
 #define DOBOZ_FORCEINLINE inline
 #endif
 
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+#define DOBOZ_HAS_RVALUE_REFERENCES
+#endif
+
 namespace doboz {
 
-const int VERSION = 0; // encoding format
+const int VERSION = 5; // encoding format
+
+// The window size is the maximum distance of matches, and it must be a power of 2
+// Larger windows improve the compression ratio of data with distant repeats, but the compressor needs more memory
+const int MIN_WINDOW_SIZE_LOG = 16; // 64 KB
+const int MAX_WINDOW_SIZE_LOG = 28; // 256 MB
+const int DEFAULT_WINDOW_SIZE_LOG = 21; // 2 MB
 
 enum Result
 {
@@ -40,6 +51,17 @@ enum Result
 	RESULT_ERROR_BUFFER_TOO_SMALL,
 	RESULT_ERROR_CORRUPTED_DATA,
 	RESULT_ERROR_UNSUPPORTED_VERSION,
+	RESULT_ERROR_INVALID_SEQUENCES,
+	RESULT_ERROR_COMPRESSED_DATA_TOO_LARGE, // the compressed data does not fit into the destination
+};
+
+// A run of literals followed by a match
+// The literals are the consecutive bytes of the uncompressed data, which precede the match
+struct Sequence
+{
+	size_t literalLength;
+	int matchLength; // 0 if there is no match (the last sequence)
+	int offset;
 };
 
 
@@ -56,6 +78,7 @@ struct Header
 	uint64_t uncompressedSize;
 	uint64_t compressedSize;
 	int version;
+	int windowSizeLog;
 	bool isStored;
 };
 
@@ -65,10 +88,84 @@ const int WORD_SIZE = 4; // uint32_t
 const int MIN_MATCH_LENGTH = 3;
 const int MAX_MATCH_LENGTH = 255 + MIN_MATCH_LENGTH;
 const int MAX_MATCH_CANDIDATE_COUNT = 128;
-const int DICTIONARY_SIZE = 1 << 21; // 2 MB, must be a power of 2!
+
+// The match finders may use a smaller window than the encoding format, which reduces their memory usage
+const int MIN_MATCH_FINDER_WINDOW_SIZE_LOG = 12;
+const int MAX_HASH_TABLE_SIZE_LOG = 20; // a hash table larger than the window would only slow down clearing it
 
 const int TAIL_LENGTH = 2 * WORD_SIZE; // prevents fast write operations from writing beyond the end of the buffer during decoding
-const int TRAILING_DUMMY_SIZE = WORD_SIZE; // safety trailing bytes which decrease the number of necessary buffer checks
+
+const int MIN_LITERAL_RUN_LENGTH = 32; // shorter literal runs are encoded as individual literals
+const uint8_t LITERAL_RUN_CODE = 0; // the first byte of a literal run, same as a 1-byte match code with a zero offset
+
+const int INITIAL_REPEAT_OFFSET = 1; // the repeated offset before the first match
+
+const int LONG_MATCH_CODE_OFFSET_BIT_COUNT = 21; // the number of offset bits in a 4-byte match code
+
+const int MAX_VAR_INT_SIZE = 4;
+const uint32_t MAX_VAR_INT_VALUE = (1u << (7 * MAX_VAR_INT_SIZE)) - 1;
+
+const int MAX_EXTENDED_MATCH_LENGTH = MAX_MATCH_LENGTH + static_cast<int>(MAX_VAR_INT_VALUE); // maximum length of a match with a length extension
+
+
+// Parameters which depend on the version of the encoding format
+// Every version extends the previous one
+template <int version>
+struct Format;
+
+template <>
+struct Format<0>
+{
+	typedef uint32_t ControlWord;
+
+	static const int CONTROL_WORD_SIZE = sizeof(ControlWord);
+	static const int TRAILING_DUMMY_SIZE = CONTROL_WORD_SIZE; // safety trailing bytes which decrease the number of necessary buffer checks
+
+	static const bool HAS_LITERAL_RUNS = false;
+	static const bool HAS_REPEAT_OFFSETS = false;
+	static const bool HAS_LONG_MATCHES = false;
+	static const bool HAS_WIDE_OFFSETS = false;
+
+	static const int MAX_MATCH_CODED_SIZE = WORD_SIZE;
+};
+
+template <>
+struct Format<1> : Format<0>
+{
+	typedef uint64_t ControlWord; // 63 literal/match bits per control word instead of 31
+
+	static const int CONTROL_WORD_SIZE = sizeof(ControlWord);
+	static const int TRAILING_DUMMY_SIZE = CONTROL_WORD_SIZE;
+};
+
+template <>
+struct Format<2> : Format<1>
+{
+	static const bool HAS_LITERAL_RUNS = true; // a match control bit followed by LITERAL_RUN_CODE, the varint run length and the raw literals
+};
+
+template <>
+struct Format<3> : Format<2>
+{
+	static const bool HAS_REPEAT_OFFSETS = true; // a zero match offset stands for the offset of the previous match
+};
+
+template <>
+struct Format<4> : Format<3>
+{
+	static const bool HAS_LONG_MATCHES = true; // the maximum length code is followed by the varint extension of the match length
+
+	static const int MAX_MATCH_CODED_SIZE = WORD_SIZE + MAX_VAR_INT_SIZE;
+};
+
+template <>
+struct Format<5> : Format<4>
+{
+	static const bool HAS_WIDE_OFFSETS = true; // with windows larger than 2 MB, 4-byte match codes are followed by the high bits of the offset
+	static const int MAX_OFFSET_EXTENSION_SIZE = (MAX_WINDOW_SIZE_LOG - LONG_MATCH_CODE_OFFSET_BIT_COUNT + 7) / 8;
+
+	static const int MAX_MATCH_CODED_SIZE = WORD_SIZE + MAX_OFFSET_EXTENSION_SIZE + MAX_VAR_INT_SIZE;
+};
 
 
 // Reads up to 4 bytes and returns them in a word
@@ -122,6 +219,69 @@ DOBOZ_FORCEINLINE void fastWrite(void* destination, uint32_t word, size_t size)
 	}
 }
 
+// Reads a whole machine word (e.g. a control word)
+template <typename T>
+DOBOZ_FORCEINLINE T fastReadWord(const void* source)
+{
+	return *reinterpret_cast<const T*>(source);
+}
+
+// Writes a whole machine word (e.g. a control word)
+template <typename T>
+DOBOZ_FORCEINLINE void fastWriteWord(void* destination, T word)
+{
+	*reinterpret_cast<T*>(destination) = word;
+}
+
+// Encodes an integer with a variable number of bytes and returns the size of the code
+// Every byte contains 7 bits of the value, the highest bit marks that more bytes follow
+// If the destination is null, only the size is computed
+DOBOZ_FORCEINLINE int encodeVarInt(uint32_t value, void* destination)
+{
+	assert(value <= MAX_VAR_INT_VALUE);
+
+	uint8_t* outputIterator = static_cast<uint8_t*>(destination);
+	int size = 1;
+
+	while (value >= 128)
+	{
+		if (outputIterator != 0)
+		{
+			*outputIterator++ = static_cast<uint8_t>(value | 128);
+		}
+
+		value >>= 7;
+		++size;
+	}
+
+	if (outputIterator != 0)
+	{
+		*outputIterator = static_cast<uint8_t>(value);
+	}
+
+	return size;
+}
+
+// Decodes a variable length integer and returns the size of the code
+// Reads at most MAX_VAR_INT_SIZE bytes, and returns 0 if the code is longer than that
+DOBOZ_FORCEINLINE int decodeVarInt(uint32_t& value, const void* source)
+{
+	const uint8_t* inputIterator = static_cast<const uint8_t*>(source);
+	value = 0;
+
+	for (int i = 0; i < MAX_VAR_INT_SIZE; ++i)
+	{
+		value |= static_cast<uint32_t>(inputIterator[i] & 127) << (7 * i);
+
+		if ((inputIterator[i] & 128) == 0)
+		{
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
 } // namespace detail
 
 } // namespace doboz
\ No newline at end of file
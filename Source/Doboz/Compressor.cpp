@@ -18,15 +18,1109 @@
 
 #include <cstring>
 #include <algorithm>
+#include <vector>
 #include "Compressor.h"
+#include "SuffixArrayMatchFinder.h"
+#include "LongDistanceMatcher.h"
+#include "PipelinedMatchFinder.h"
+#include "Thread.h"
+#include "../Utils/Timer.h"
 
 namespace doboz {
 
 using namespace detail;
 
+namespace {
+
+// Shared pool of compressors with the default parameters
+// At most MAX_COMPRESSOR_COUNT unused compressors are kept, the others are deleted when they are returned
+class CompressorPool
+{
+public:
+	CompressorPool()
+	{
+		// Returning a compressor must not allocate memory
+		compressors_.reserve(MAX_COMPRESSOR_COUNT);
+	}
+
+	~CompressorPool()
+	{
+		for (size_t i = 0; i < compressors_.size(); ++i)
+		{
+			delete compressors_[i];
+		}
+	}
+
+	// Returns an unused compressor, or a new one if there are none
+	Compressor* acquire()
+	{
+		Compressor* compressor = 0;
+
+		mutex_.lock();
+		if (!compressors_.empty())
+		{
+			compressor = compressors_.back();
+			compressors_.pop_back();
+		}
+		mutex_.unlock();
+
+		return (compressor != 0) ? compressor : new Compressor();
+	}
+
+	// Returns the compressor to the pool, or deletes it if the pool is full
+	void release(Compressor* compressor)
+	{
+		mutex_.lock();
+		bool isKept = (compressors_.size() < static_cast<size_t>(MAX_COMPRESSOR_COUNT));
+		if (isKept)
+		{
+			compressors_.push_back(compressor);
+		}
+		mutex_.unlock();
+
+		if (!isKept)
+		{
+			delete compressor;
+		}
+	}
+
+private:
+	static const int MAX_COMPRESSOR_COUNT = 4; // every compressor keeps the memory of its match finder (about 20 MB)
+
+	Mutex mutex_;
+	std::vector<Compressor*> compressors_;
+};
+
+// The pool is created on first use, so it is destroyed only after the static objects which used it before
+CompressorPool& getCompressorPool()
+{
+	static CompressorPool compressorPool;
+	return compressorPool;
+}
+
+// Function-local statics are not initialized thread-safely by every supported compiler, so the pool is created before main
+CompressorPool& initialCompressorPool = getCompressorPool();
+
+// Takes a compressor from the pool, and deletes it if it is not returned, because the compression was interrupted by an exception
+class PooledCompressor
+{
+public:
+	PooledCompressor()
+		: compressor_(getCompressorPool().acquire())
+	{
+	}
+
+	~PooledCompressor()
+	{
+		delete compressor_;
+	}
+
+	Compressor& get()
+	{
+		return *compressor_;
+	}
+
+	void release()
+	{
+		getCompressorPool().release(compressor_);
+		compressor_ = 0;
+	}
+
+private:
+	Compressor* compressor_;
+
+	// Non-copyable
+	PooledCompressor(const PooledCompressor&);
+	PooledCompressor& operator =(const PooledCompressor&);
+};
+
+} // namespace
+
+Compressor::Compressor(int windowSizeLog, bool longDistanceMatching, MatchFinderType matchFinderType, int threadCount)
+	: windowSizeLog_(windowSizeLog),
+	  longDistanceMatching_(longDistanceMatching),
+	  matchFinderType_(matchFinderType),
+	  threadCount_(threadCount),
+	  matchFinderWindowSizeLog_(longDistanceMatching ? std::min(windowSizeLog, DEFAULT_WINDOW_SIZE_LOG) : windowSizeLog), // with long-distance matching, the other matches are found only in a smaller window
+	  hashTableSizeLog_(MAX_HASH_TABLE_SIZE_LOG),
+	  maxChainLength_(HashChainMatchFinder::DEFAULT_MAX_CHAIN_LENGTH),
+	  level_(COMPRESSION_LEVEL_DEFAULT),
+	  tuningTarget_(TUNING_TARGET_NONE),
+	  tuningTargetValue_(0.0),
+	  tuningDebt_(0.0)
+{
+	assert(windowSizeLog >= MIN_WINDOW_SIZE_LOG && windowSizeLog <= MAX_WINDOW_SIZE_LOG);
+	assert(threadCount >= 1 && threadCount <= MAX_THREAD_COUNT);
+
+	reset();
+}
+
+Compressor::Compressor(const MemoryBudget& memoryBudget)
+	: longDistanceMatching_(false),
+	  threadCount_(1),
+	  maxChainLength_(HashChainMatchFinder::DEFAULT_MAX_CHAIN_LENGTH),
+	  level_(COMPRESSION_LEVEL_DEFAULT),
+	  tuningTarget_(TUNING_TARGET_NONE),
+	  tuningTargetValue_(0.0),
+	  tuningDebt_(0.0)
+{
+	reset();
+
+	// Select the largest window whose match finder fits into the budget
+	// The binary tree needs twice as much memory as the hash chain with the same window
+	// The hash chain with a twice as large window usually compresses better, so it is tried first
+	// Smaller hash tables barely affect the compression ratio, so they are only a quarter of the window
+	for (matchFinderWindowSizeLog_ = MAX_WINDOW_SIZE_LOG; ; --matchFinderWindowSizeLog_)
+	{
+		hashTableSizeLog_ = std::min(matchFinderWindowSizeLog_ - 2, MAX_HASH_TABLE_SIZE_LOG);
+
+		matchFinderType_ = MATCH_FINDER_BINARY_TREE;
+		if (getMemoryUsage(0) <= memoryBudget.size)
+		{
+			break;
+		}
+
+		matchFinderType_ = MATCH_FINDER_HASH_CHAIN;
+		if (getMemoryUsage(0) <= memoryBudget.size || matchFinderWindowSizeLog_ == MIN_MATCH_FINDER_WINDOW_SIZE_LOG)
+		{
+			break;
+		}
+	}
+
+	// The encoding format does not support windows smaller than the minimum
+	windowSizeLog_ = std::max(matchFinderWindowSizeLog_, MIN_WINDOW_SIZE_LOG);
+}
+
+Compressor::Compressor(CompressionLevel level, int threadCount)
+	: longDistanceMatching_(false),
+	  threadCount_(threadCount),
+	  hashTableSizeLog_(MAX_HASH_TABLE_SIZE_LOG),
+	  tuningTarget_(TUNING_TARGET_NONE),
+	  tuningTargetValue_(0.0),
+	  tuningDebt_(0.0)
+{
+	assert(threadCount >= 1 && threadCount <= MAX_THREAD_COUNT);
+
+	setLevel(level);
+	reset();
+}
+
+Compressor::Compressor(const ThroughputTarget& target)
+	: longDistanceMatching_(false),
+	  threadCount_(1),
+	  hashTableSizeLog_(MAX_HASH_TABLE_SIZE_LOG),
+	  tuningTarget_(TUNING_TARGET_THROUGHPUT),
+	  tuningTargetValue_(target.mebibytesPerSecond * 1024.0 * 1024.0),
+	  tuningDebt_(0.0)
+{
+	assert(target.mebibytesPerSecond > 0.0);
+
+	// The speed is more important than the ratio, so the fastest level is tried first
+	setTunedLevel(COMPRESSION_LEVEL_FASTEST);
+	reset();
+}
+
+Compressor::Compressor(const RatioTarget& target)
+	: longDistanceMatching_(false),
+	  threadCount_(1),
+	  hashTableSizeLog_(MAX_HASH_TABLE_SIZE_LOG),
+	  tuningTarget_(TUNING_TARGET_RATIO),
+	  tuningTargetValue_(target.ratio),
+	  tuningDebt_(0.0)
+{
+	assert(target.ratio > 0.0);
+
+	// The ratio is more important than the speed, so the level with the best ratio is tried first
+	setTunedLevel(COMPRESSION_LEVEL_DEFAULT);
+	reset();
+}
+
+#ifdef DOBOZ_HAS_RVALUE_REFERENCES
+Compressor::Compressor(Compressor&& other)
+	: windowSizeLog_(other.windowSizeLog_),
+	  longDistanceMatching_(other.longDistanceMatching_),
+	  matchFinderType_(other.matchFinderType_),
+	  threadCount_(other.threadCount_),
+	  matchFinderWindowSizeLog_(other.matchFinderWindowSizeLog_),
+	  hashTableSizeLog_(other.hashTableSizeLog_),
+	  maxChainLength_(other.maxChainLength_),
+	  level_(other.level_),
+	  tuningTarget_(other.tuningTarget_),
+	  tuningTargetValue_(other.tuningTargetValue_),
+	  tuningDebt_(other.tuningDebt_)
+{
+	reset();
+	swap(other);
+}
+
+Compressor& Compressor::operator =(Compressor&& other)
+{
+	swap(other);
+	return *this;
+}
+#endif
+
+Compressor::~Compressor()
+{
+	// The pipelined match finders refer to the other match finders, so they must be destroyed first
+	delete pipelinedDictionary_;
+	delete pipelinedSuffixArrayMatchFinder_;
+	delete dictionary_;
+	delete suffixArrayMatchFinder_;
+	delete hashChainMatchFinder_;
+	delete longDistanceMatcher_;
+
+	for (int i = 0; i < MAX_THREAD_COUNT; ++i)
+	{
+		delete threadDictionaries_[i];
+		delete threadLongDistanceMatchers_[i];
+	}
+
+	delete[] estimationHashTable_;
+	delete[] gatherBuffer_;
+}
+
+void Compressor::swap(Compressor& other)
+{
+	std::swap(windowSizeLog_, other.windowSizeLog_);
+	std::swap(longDistanceMatching_, other.longDistanceMatching_);
+	std::swap(matchFinderType_, other.matchFinderType_);
+	std::swap(threadCount_, other.threadCount_);
+	std::swap(matchFinderWindowSizeLog_, other.matchFinderWindowSizeLog_);
+	std::swap(hashTableSizeLog_, other.hashTableSizeLog_);
+	std::swap(maxChainLength_, other.maxChainLength_);
+	std::swap(level_, other.level_);
+	std::swap(tuningTarget_, other.tuningTarget_);
+	std::swap(tuningTargetValue_, other.tuningTargetValue_);
+	std::swap(tuningDebt_, other.tuningDebt_);
+
+	std::swap(reservedSourceSize_, other.reservedSourceSize_);
+	std::swap(dictionary_, other.dictionary_);
+	std::swap(suffixArrayMatchFinder_, other.suffixArrayMatchFinder_);
+	std::swap(hashChainMatchFinder_, other.hashChainMatchFinder_);
+	std::swap(longDistanceMatcher_, other.longDistanceMatcher_);
+	std::swap(pipelinedDictionary_, other.pipelinedDictionary_);
+	std::swap(pipelinedSuffixArrayMatchFinder_, other.pipelinedSuffixArrayMatchFinder_);
+
+	for (int i = 0; i < MAX_THREAD_COUNT; ++i)
+	{
+		std::swap(threadDictionaries_[i], other.threadDictionaries_[i]);
+		std::swap(threadLongDistanceMatchers_[i], other.threadLongDistanceMatchers_[i]);
+	}
+
+	std::swap(estimationHashTable_, other.estimationHashTable_);
+	std::swap(estimationBase_, other.estimationBase_);
+	std::swap(gatherBuffer_, other.gatherBuffer_);
+	std::swap(gatherBufferSize_, other.gatherBufferSize_);
+}
+
+// Sets the parameters of a compression level
+void Compressor::setLevel(CompressionLevel level)
+{
+	switch (level)
+	{
+	case COMPRESSION_LEVEL_FASTEST:
+		setLevel<CompressionConfig<COMPRESSION_LEVEL_FASTEST> >(level);
+		break;
+
+	case COMPRESSION_LEVEL_FAST:
+		setLevel<CompressionConfig<COMPRESSION_LEVEL_FAST> >(level);
+		break;
+
+	case COMPRESSION_LEVEL_MAX:
+		setLevel<CompressionConfig<COMPRESSION_LEVEL_MAX> >(level);
+		break;
+
+	case COMPRESSION_LEVEL_FAST_DECOMPRESSION:
+		setLevel<CompressionConfig<COMPRESSION_LEVEL_FAST_DECOMPRESSION> >(level);
+		break;
+
+	default:
+		setLevel<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(COMPRESSION_LEVEL_DEFAULT);
+		break;
+	}
+}
+
+template <class Config>
+void Compressor::setLevel(CompressionLevel level)
+{
+	windowSizeLog_ = Config::WINDOW_SIZE_LOG;
+	matchFinderType_ = Config::MATCH_FINDER_TYPE;
+	matchFinderWindowSizeLog_ = Config::WINDOW_SIZE_LOG;
+	maxChainLength_ = Config::MAX_CHAIN_LENGTH;
+	level_ = level;
+}
+
+void Compressor::reset()
+{
+	reservedSourceSize_ = 0;
+	dictionary_ = 0;
+	suffixArrayMatchFinder_ = 0;
+	hashChainMatchFinder_ = 0;
+	longDistanceMatcher_ = 0;
+	pipelinedDictionary_ = 0;
+	pipelinedSuffixArrayMatchFinder_ = 0;
+
+	for (int i = 0; i < MAX_THREAD_COUNT; ++i)
+	{
+		threadDictionaries_[i] = 0;
+		threadLongDistanceMatchers_[i] = 0;
+	}
+
+	estimationHashTable_ = 0;
+	estimationBase_ = 0;
+
+	gatherBuffer_ = 0;
+	gatherBufferSize_ = 0;
+}
+
+// Creates the match finders required by the parameters, if they do not exist yet
+// The match finders allocate their memory only when they are first used
+void Compressor::initialize()
+{
+	if (matchFinderType_ == MATCH_FINDER_SUFFIX_ARRAY && suffixArrayMatchFinder_ == 0)
+	{
+		suffixArrayMatchFinder_ = new SuffixArrayMatchFinder(matchFinderWindowSizeLog_, threadCount_);
+		pipelinedSuffixArrayMatchFinder_ = new PipelinedMatchFinder<SuffixArrayMatchFinder>(*suffixArrayMatchFinder_);
+	}
+
+	if (matchFinderType_ == MATCH_FINDER_HASH_CHAIN && hashChainMatchFinder_ == 0)
+	{
+		hashChainMatchFinder_ = new HashChainMatchFinder(matchFinderWindowSizeLog_, hashTableSizeLog_, maxChainLength_);
+	}
+	else if (matchFinderType_ == MATCH_FINDER_HASH_CHAIN)
+	{
+		// The automatically selected levels may have different chain lengths, but they have the same window
+		assert(hashChainMatchFinder_->windowSizeLog() == matchFinderWindowSizeLog_);
+		hashChainMatchFinder_->setMaxChainLength(maxChainLength_);
+	}
+
+	if (matchFinderType_ == MATCH_FINDER_BINARY_TREE && dictionary_ == 0)
+	{
+		dictionary_ = new Dictionary(matchFinderWindowSizeLog_, hashTableSizeLog_);
+		pipelinedDictionary_ = new PipelinedMatchFinder<Dictionary>(*dictionary_);
+	}
+
+	if (longDistanceMatching_ && longDistanceMatcher_ == 0)
+	{
+		longDistanceMatcher_ = new LongDistanceMatcher(windowSizeLog_);
+	}
+}
+
+// Creates the match finders of the additional threads which compress the segments, if they do not exist yet
+void Compressor::initializeSegments(int segmentCount)
+{
+	for (int i = 1; i < segmentCount; ++i)
+	{
+		if (threadDictionaries_[i] == 0)
+		{
+			threadDictionaries_[i] = new Dictionary(matchFinderWindowSizeLog_, hashTableSizeLog_);
+		}
+
+		if (longDistanceMatching_ && threadLongDistanceMatchers_[i] == 0)
+		{
+			threadLongDistanceMatchers_[i] = new LongDistanceMatcher(windowSizeLog_);
+		}
+	}
+}
+
+// Returns the number of threads which compress a block at the specified level
+// The fast levels and the fast decompression level compress only on the calling thread
+int Compressor::getLevelThreadCount(CompressionLevel level) const
+{
+	if (level == COMPRESSION_LEVEL_FASTEST || level == COMPRESSION_LEVEL_FAST || level == COMPRESSION_LEVEL_FAST_DECOMPRESSION)
+	{
+		return 1;
+	}
+
+	return threadCount_;
+}
+
+// Returns the number of segments compressed in parallel by the binary tree match finder
+// If it is less than 2, the block is compressed without splitting it
+int Compressor::getSegmentCount(size_t bufferLength) const
+{
+	// Every segment is compressed after priming the match finder with a window of the preceding data
+	// The segments should be much longer than the window, because the priming takes time
+	size_t minSegmentLength = static_cast<size_t>(MIN_SEGMENT_LENGTH_WINDOW_RATIO) << matchFinderWindowSizeLog_;
+	return static_cast<int>(std::min(bufferLength / minSegmentLength, static_cast<size_t>(threadCount_)));
+}
+
+void Compressor::reserve(size_t maxSourceSize)
+{
+	if (tuningTarget_ == TUNING_TARGET_NONE)
+	{
+		reserveMatchFinders(maxSourceSize);
+		return;
+	}
+
+	for (int level = COMPRESSION_LEVEL_FASTEST; level <= MAX_TUNED_LEVEL; ++level)
+	{
+		reserve(maxSourceSize, static_cast<CompressionLevel>(level));
+	}
+
+	reservedSourceSize_ = std::max(reservedSourceSize_, maxSourceSize);
+}
+
+void Compressor::reserve(size_t maxSourceSize, CompressionLevel level)
+{
+	assert(level == level_ || (tuningTarget_ != TUNING_TARGET_NONE && level <= MAX_TUNED_LEVEL));
+
+	if (tuningTarget_ == TUNING_TARGET_NONE)
+	{
+		reserveMatchFinders(maxSourceSize);
+		return;
+	}
+
+	// The parameters of the level are selected only while its match finders are reserved
+	CompressionLevel currentLevel = level_;
+	setTunedLevel(level);
+	reserveMatchFinders(maxSourceSize);
+	setTunedLevel(currentLevel);
+}
+
+// Allocates the memory of the match finders required by the current parameters
+void Compressor::reserveMatchFinders(size_t maxSourceSize)
+{
+	initialize();
+
+	// The structures of the other threads are reserved only if the level uses them
+	bool isThreaded = getLevelThreadCount(level_) > 1;
+
+	if (matchFinderType_ == MATCH_FINDER_SUFFIX_ARRAY)
+	{
+		suffixArrayMatchFinder_->reserve(maxSourceSize);
+
+		if (isThreaded)
+		{
+			pipelinedSuffixArrayMatchFinder_->reserve();
+		}
+	}
+	else if (matchFinderType_ == MATCH_FINDER_HASH_CHAIN)
+	{
+		hashChainMatchFinder_->reserve();
+	}
+	else
+	{
+		dictionary_->reserve();
+
+		// Smaller blocks may be compressed without splitting them
+		if (isThreaded)
+		{
+			pipelinedDictionary_->reserve();
+		}
+
+		int segmentCount = isThreaded ? getSegmentCount(maxSourceSize) : 1;
+		initializeSegments(segmentCount);
+
+		for (int i = 1; i < segmentCount; ++i)
+		{
+			threadDictionaries_[i]->reserve();
+
+			if (longDistanceMatching_)
+			{
+				threadLongDistanceMatchers_[i]->reserve();
+			}
+		}
+	}
+
+	if (longDistanceMatching_)
+	{
+		longDistanceMatcher_->reserve();
+	}
+
+	// The estimation does not allocate memory either
+	reserveEstimation();
+}
+
+size_t Compressor::getMemoryUsage(size_t maxSourceSize, bool hasChunks) const
+{
+	size_t memoryUsage = sizeof(Compressor);
+
+	if (tuningTarget_ != TUNING_TARGET_NONE)
+	{
+		// The fastest and the fast levels share a hash chain match finder, and the default level uses a binary tree
+		memoryUsage += getMatchFinderMemoryUsage(MATCH_FINDER_HASH_CHAIN, getTunedHashChainWindowSizeLog(), getLevelThreadCount(COMPRESSION_LEVEL_FAST), maxSourceSize) +
+			getMatchFinderMemoryUsage(MATCH_FINDER_BINARY_TREE, CompressionConfig<COMPRESSION_LEVEL_DEFAULT>::WINDOW_SIZE_LOG, getLevelThreadCount(COMPRESSION_LEVEL_DEFAULT), maxSourceSize);
+	}
+	else
+	{
+		memoryUsage += getMatchFinderMemoryUsage(matchFinderType_, matchFinderWindowSizeLog_, getLevelThreadCount(level_), maxSourceSize);
+	}
+
+	if (hasChunks)
+	{
+		memoryUsage += maxSourceSize;
+	}
+
+	memoryUsage += sizeof(size_t) << getEstimationHashTableSizeLog();
+
+	return memoryUsage;
+}
+
+// Returns the memory used by the match finders of the specified type and their threads, and by the temporary buffers of the compression
+size_t Compressor::getMatchFinderMemoryUsage(MatchFinderType matchFinderType, int matchFinderWindowSizeLog, int threadCount, size_t maxSourceSize) const
+{
+	size_t memoryUsage = 0;
+	int matchFinderCount = 1;
+
+	if (matchFinderType == MATCH_FINDER_SUFFIX_ARRAY)
+	{
+		memoryUsage += SuffixArrayMatchFinder::getMemorySize(matchFinderWindowSizeLog, threadCount_, maxSourceSize);
+
+		if (threadCount > 1)
+		{
+			memoryUsage += PipelinedMatchFinder<SuffixArrayMatchFinder>::getMemorySize();
+		}
+	}
+	else if (matchFinderType == MATCH_FINDER_HASH_CHAIN)
+	{
+		memoryUsage += HashChainMatchFinder::getMemorySize(matchFinderWindowSizeLog, hashTableSizeLog_);
+	}
+	else
+	{
+		if (threadCount > 1)
+		{
+			memoryUsage += PipelinedMatchFinder<Dictionary>::getMemorySize();
+		}
+
+		// Every segment has its own match finders, and it is compressed into a temporary buffer
+		int segmentCount = threadCount > 1 ? getSegmentCount(maxSourceSize) : 1;
+
+		if (segmentCount > 1)
+		{
+			matchFinderCount = segmentCount;
+			memoryUsage += static_cast<size_t>(getMaxCompressedSize(maxSourceSize));
+		}
+
+		memoryUsage += matchFinderCount * Dictionary::getMemorySize(matchFinderWindowSizeLog, hashTableSizeLog_);
+	}
+
+	if (longDistanceMatching_)
+	{
+		memoryUsage += matchFinderCount * LongDistanceMatcher::getMemorySize(windowSizeLog_);
+	}
+
+	return memoryUsage;
+}
+
 Result Compressor::compress(const void* source, size_t sourceSize, void* destination, size_t destinationSize, size_t& compressedSize)
+{
+	if (tuningTarget_ != TUNING_TARGET_NONE)
+	{
+		return compressTuned(source, sourceSize, destination, destinationSize, compressedSize);
+	}
+
+	return compress(source, sourceSize, destination, destinationSize, compressedSize, threadCount_);
+}
+
+Result Compressor::compress(const SourceChunk* chunks, size_t chunkCount, void* destination, size_t destinationSize, size_t& compressedSize)
+{
+	assert(chunks != 0 || chunkCount == 0);
+
+	// A single chunk is already contiguous
+	if (chunkCount == 1)
+	{
+		return compress(chunks[0].data, chunks[0].size, destination, destinationSize, compressedSize);
+	}
+
+	size_t sourceSize = 0;
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		sourceSize += chunks[i].size;
+	}
+
+	if (sourceSize == 0)
+	{
+		return RESULT_ERROR_BUFFER_TOO_SMALL;
+	}
+
+	// The buffer is reallocated only if it is too small
+	if (gatherBufferSize_ < sourceSize)
+	{
+		delete[] gatherBuffer_;
+		gatherBuffer_ = new uint8_t[sourceSize];
+		gatherBufferSize_ = sourceSize;
+	}
+
+	uint8_t* gatherIterator = gatherBuffer_;
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		assert(chunks[i].data != 0 || chunks[i].size == 0);
+
+		if (chunks[i].size > 0)
+		{
+			memcpy(gatherIterator, chunks[i].data, chunks[i].size);
+			gatherIterator += chunks[i].size;
+		}
+	}
+
+	return compress(gatherBuffer_, sourceSize, destination, destinationSize, compressedSize);
+}
+
+// Compresses a block of data with the automatically selected level on a single thread, and selects the level of the next block
+Result Compressor::compressTuned(const void* source, size_t sourceSize, void* destination, size_t destinationSize, size_t& compressedSize)
+{
+	// The match finders of every level are allocated before the first measurement, so selecting another level does not allocate memory
+	// This is done only once for a stream of blocks, unless a block is larger than the previous ones
+	if (sourceSize > reservedSourceSize_)
+	{
+		reserve(sourceSize);
+	}
+
+	afra::Timer timer;
+	Result result = compress(source, sourceSize, destination, destinationSize, compressedSize, 1);
+	double time = timer.query();
+
+	// The compressed size is unknown if the compression has failed
+	if (result != RESULT_OK)
+	{
+		return result;
+	}
+
+	// The debt is like the backlog of a queue: a block which is compressed faster than needed cannot make up for the later blocks
+	double debt = (tuningTarget_ == TUNING_TARGET_THROUGHPUT) ? time - static_cast<double>(sourceSize) / tuningTargetValue_ :
+		static_cast<double>(compressedSize) - static_cast<double>(sourceSize) * tuningTargetValue_;
+	tuningDebt_ = std::max(tuningDebt_ + debt, 0.0);
+
+	// If the previous blocks have not reached the target, and neither has the current one, the next level is faster for a throughput target, and better for a ratio target
+	// If there is no debt, the next level is changed in the other direction
+	// Otherwise the current level is kept until the debt is paid
+	int catchUpStep = (tuningTarget_ == TUNING_TARGET_THROUGHPUT) ? -1 : 1;
+	int level = level_;
+
+	if (tuningDebt_ > 0.0 && debt > 0.0)
+	{
+		level += catchUpStep;
+	}
+	else if (tuningDebt_ == 0.0)
+	{
+		level -= catchUpStep;
+	}
+
+	level = std::min(std::max(level, static_cast<int>(COMPRESSION_LEVEL_FASTEST)), static_cast<int>(MAX_TUNED_LEVEL));
+
+	if (level != level_)
+	{
+		setTunedLevel(static_cast<CompressionLevel>(level));
+	}
+
+	return RESULT_OK;
+}
+
+// Sets the parameters of an automatically selected level
+void Compressor::setTunedLevel(CompressionLevel level)
+{
+	setLevel(level);
+
+	// The fastest and the fast levels share the hash chain match finder
+	if (matchFinderType_ == MATCH_FINDER_HASH_CHAIN)
+	{
+		matchFinderWindowSizeLog_ = getTunedHashChainWindowSizeLog();
+		windowSizeLog_ = matchFinderWindowSizeLog_;
+	}
+}
+
+// Returns the window of the hash chain match finder of the automatically selected levels, which is large enough for all of them
+int Compressor::getTunedHashChainWindowSizeLog()
+{
+	return std::max(static_cast<int>(CompressionConfig<COMPRESSION_LEVEL_FASTEST>::WINDOW_SIZE_LOG), static_cast<int>(CompressionConfig<COMPRESSION_LEVEL_FAST>::WINDOW_SIZE_LOG));
+}
+
+double Compressor::estimate(const void* source, size_t sourceSize)
+{
+	assert(source != 0);
+
+	if (sourceSize == 0)
+	{
+		return 0.0;
+	}
+
+	const uint8_t* buffer = static_cast<const uint8_t*>(source);
+	size_t windowSize = static_cast<size_t>(1) << windowSizeLog_;
+
+	// Matches must not reach into the tail of the block
+	size_t matchableLength = (sourceSize > TAIL_LENGTH + MIN_MATCH_LENGTH) ? sourceSize - (TAIL_LENGTH + MIN_MATCH_LENGTH) : 0;
+	size_t maxMatchEnd = (sourceSize > TAIL_LENGTH) ? sourceSize - TAIL_LENGTH : 0;
+
+	// The hash table has about one entry for every indexed position, but it is kept small enough to stay in the cache
+	int maxHashTableSizeLog = getEstimationHashTableSizeLog();
+	int hashTableSizeLog = ESTIMATION_MIN_HASH_TABLE_SIZE_LOG;
+	while (hashTableSizeLog < maxHashTableSizeLog && (static_cast<size_t>(ESTIMATION_INDEX_STRIDE) << hashTableSizeLog) < sourceSize)
+	{
+		++hashTableSizeLog;
+	}
+
+	const size_t hashTableSize = static_cast<size_t>(1) << hashTableSizeLog;
+
+	// The last indexed position for every hash value, offset by the base
+	// The entries less than the base are from the previous blocks, so the table is cleared only when the base would overflow
+	reserveEstimation();
+
+	const size_t maxBase = static_cast<size_t>(-1);
+	if (estimationBase_ > maxBase - sourceSize)
+	{
+		std::fill(estimationHashTable_, estimationHashTable_ + (static_cast<size_t>(1) << maxHashTableSizeLog), static_cast<size_t>(0));
+		estimationBase_ = 1;
+	}
+
+	size_t* hashTable = estimationHashTable_;
+	const size_t base = estimationBase_;
+	estimationBase_ += sourceSize;
+
+	double sampledRatioSum = 0.0;
+	size_t indexPosition = 0;
+
+	// The number of samples is limited, so the parsed data is a small part of the block regardless of its size
+	// Many short samples spread over the whole block are more representative than a few long ones
+	size_t sampleCount = std::min(std::max(matchableLength / ESTIMATION_SAMPLE_INTERVAL, static_cast<size_t>(1)), static_cast<size_t>(ESTIMATION_MAX_SAMPLE_COUNT));
+	size_t sampleInterval = std::max(matchableLength / sampleCount, static_cast<size_t>(ESTIMATION_SAMPLE_LENGTH));
+
+	// Only the positions which fit into the hash table are indexed before a sample
+	size_t maxIndexLength = hashTableSize * ESTIMATION_INDEX_STRIDE;
+
+	for (size_t sampleIndex = 0; sampleIndex < sampleCount && matchableLength > 0; ++sampleIndex)
+	{
+		// The samples are taken from the middle of the intervals, so that they have about as much preceding data to match as the average position
+		size_t sampleStart = std::min(sampleInterval * sampleIndex + (sampleInterval - ESTIMATION_SAMPLE_LENGTH) / 2, matchableLength - 1);
+
+		// Only every few positions are indexed before the sample, so matches are found only if they are long enough to contain an indexed position
+		if (sampleStart > maxIndexLength)
+		{
+			indexPosition = std::max(indexPosition, sampleStart - maxIndexLength);
+		}
+
+		for (; indexPosition < sampleStart; indexPosition += ESTIMATION_INDEX_STRIDE)
+		{
+			hashTable[Dictionary::hash(buffer + indexPosition) & (hashTableSize - 1)] = base + indexPosition;
+		}
+
+		// Parse the sample greedily, indexing all of its positions
+		// The offset of the previous match and the match at the hashed position are checked, and the one which saves more is selected
+		size_t sampleEnd = std::min(sampleStart + ESTIMATION_SAMPLE_LENGTH, matchableLength);
+		size_t position = sampleStart;
+		double compressedSize = 0.0;
+		size_t literalCount = 0;
+		int repeatOffset = INITIAL_REPEAT_OFFSET;
+
+		while (position < sampleEnd)
+		{
+			uint32_t hashValue = Dictionary::hash(buffer + position) & (hashTableSize - 1);
+			size_t hashEntry = hashTable[hashValue];
+			hashTable[hashValue] = base + position;
+
+			// Long repeats are encoded with extended match lengths, but only the sample is parsed, so the matches may not end far after it
+			size_t maxMatchLength = std::min(maxMatchEnd - position, std::max(sampleEnd + ESTIMATION_MAX_SAMPLE_OVERRUN - position, static_cast<size_t>(MAX_MATCH_LENGTH)));
+
+			Match bestMatch;
+			int bestSaving = 0;
+			size_t bestBackwardLength = 0;
+
+			for (int candidate = 0; candidate < 2; ++candidate)
+			{
+				size_t matchPosition;
+				if (candidate == 0)
+				{
+					if (static_cast<size_t>(repeatOffset) > position)
+					{
+						continue;
+					}
+
+					matchPosition = position - repeatOffset;
+				}
+				else
+				{
+					if (hashEntry < base || position - (hashEntry - base) >= windowSize)
+					{
+						continue;
+					}
+
+					matchPosition = hashEntry - base;
+				}
+
+				size_t matchLength = 0;
+				while (matchLength < maxMatchLength && buffer[position + matchLength] == buffer[matchPosition + matchLength])
+				{
+					++matchLength;
+				}
+
+				// The match may have started before the indexed position, so extend it backwards over the pending literals
+				size_t backwardLength = 0;
+				if (matchLength >= MIN_MATCH_LENGTH)
+				{
+					while (backwardLength < literalCount && backwardLength < matchPosition && buffer[position - backwardLength - 1] == buffer[matchPosition - backwardLength - 1])
+					{
+						++backwardLength;
+					}
+				}
+
+				Match match;
+				match.length = static_cast<int>(std::min(matchLength + backwardLength, maxMatchLength));
+				match.offset = static_cast<int>(position - matchPosition);
+
+				if (match.length < MIN_MATCH_LENGTH)
+				{
+					continue;
+				}
+
+				// Breaking a long literal run also has a cost, just like in the parser
+				int matchCost = Encoder::getMatchCodedSize(match, repeatOffset, windowSizeLog_);
+				if (literalCount - backwardLength >= static_cast<size_t>(MIN_LITERAL_RUN_LENGTH))
+				{
+					matchCost += LITERAL_RUN_BREAK_COST;
+				}
+
+				if (match.length - matchCost > bestSaving)
+				{
+					bestMatch = match;
+					bestSaving = match.length - matchCost;
+					bestBackwardLength = backwardLength;
+				}
+			}
+
+			if (bestSaving > 0)
+			{
+				compressedSize += getEstimatedLiteralsCodedSize(literalCount - bestBackwardLength) + Encoder::getMatchCodedSize(bestMatch, repeatOffset, windowSizeLog_);
+				repeatOffset = bestMatch.offset;
+				literalCount = 0;
+				position += bestMatch.length - bestBackwardLength;
+				continue;
+			}
+
+			++literalCount;
+			++position;
+		}
+
+		// Every sample stands for the same part of the block, so a sample in a long run of identical bytes, which covers more data, does not outweigh the others
+		compressedSize += getEstimatedLiteralsCodedSize(literalCount);
+		sampledRatioSum += compressedSize / static_cast<double>(position - sampleStart);
+		indexPosition = std::max(indexPosition, position);
+	}
+
+	// The blocks which would expand are stored, and so are the blocks which are too small to contain matches
+	// The match finders find more and longer matches than the samples, so the saved space is scaled up (measured on binary, text and mixed data)
+	const double savingScale = 1.2;
+	double estimatedSize = static_cast<double>(sourceSize);
+	if (matchableLength > 0)
+	{
+		double sampledRatio = std::max(1.0 - (1.0 - sampledRatioSum / static_cast<double>(sampleCount)) * savingScale, 0.0);
+		estimatedSize = std::min(sampledRatio * static_cast<double>(sourceSize) + MIN_COMPRESSED_DATA_SIZE, estimatedSize);
+	}
+
+	estimatedSize += getHeaderSize(getMaxCompressedSize(sourceSize));
+	return estimatedSize / static_cast<double>(sourceSize);
+}
+
+// Allocates the hash table of the estimation, if it does not exist yet
+void Compressor::reserveEstimation()
+{
+	if (estimationHashTable_ == 0)
+	{
+		size_t hashTableSize = static_cast<size_t>(1) << getEstimationHashTableSizeLog();
+		estimationHashTable_ = new size_t[hashTableSize];
+		std::fill(estimationHashTable_, estimationHashTable_ + hashTableSize, static_cast<size_t>(0));
+		estimationBase_ = 1;
+	}
+}
+
+// Returns the size of the hash table of the estimation
+int Compressor::getEstimationHashTableSizeLog() const
+{
+	// Farther positions than the window of the match finder cannot be matched, so the table indexes at most a window of data
+	// The automatically selected levels use the largest window of the selectable levels, so the table does not depend on the current level
+	int matchFinderWindowSizeLog = (tuningTarget_ != TUNING_TARGET_NONE) ? static_cast<int>(CompressionConfig<COMPRESSION_LEVEL_DEFAULT>::WINDOW_SIZE_LOG) : matchFinderWindowSizeLog_;
+	return std::max(std::min(matchFinderWindowSizeLog - ESTIMATION_INDEX_STRIDE_LOG, static_cast<int>(ESTIMATION_MAX_HASH_TABLE_SIZE_LOG)), static_cast<int>(ESTIMATION_MIN_HASH_TABLE_SIZE_LOG));
+}
+
+// Returns the approximate coded size of a run of literals, including the control bits
+double Compressor::getEstimatedLiteralsCodedSize(size_t count)
+{
+	// Short runs are encoded with a control bit for every literal, long runs with a literal run code and the run length
+	return (count < static_cast<size_t>(MIN_LITERAL_RUN_LENGTH)) ? static_cast<double>(count) * 9.0 / 8.0 : static_cast<double>(count) + 1.0 + MAX_VAR_INT_SIZE / 2;
+}
+
+Result Compressor::compressBatch(const void* const* sources, const size_t* sourceSizes, void* const* destinations, const size_t* destinationSizes, size_t* compressedSizes, size_t count)
+{
+	assert(sources != 0 || count == 0);
+
+	// Multiple threads would only slow down the compression of small blocks
+	for (size_t i = 0; i < count; ++i)
+	{
+		Result result = (tuningTarget_ != TUNING_TARGET_NONE) ? compressTuned(sources[i], sourceSizes[i], destinations[i], destinationSizes[i], compressedSizes[i]) :
+			compress(sources[i], sourceSizes[i], destinations[i], destinationSizes[i], compressedSizes[i], 1);
+		if (result != RESULT_OK)
+		{
+			return result;
+		}
+	}
+
+	return RESULT_OK;
+}
+
+// Compresses a block of data using at most the specified number of threads
+Result Compressor::compress(const void* source, size_t sourceSize, void* destination, size_t destinationSize, size_t& compressedSize, int threadCount)
+{
+	assert(source != 0);
+	assert(destination != 0);
+
+	if (sourceSize == 0)
+	{
+		return RESULT_ERROR_BUFFER_TOO_SMALL;
+	}
+
+	const uint8_t* inputBuffer = static_cast<const uint8_t*>(source);
+	uint8_t* outputBuffer = static_cast<uint8_t*>(destination);
+	uint8_t* outputEnd = outputBuffer + destinationSize;
+	assert((inputBuffer + sourceSize <= outputBuffer || inputBuffer >= outputEnd) && "The source and destination buffers must not overlap.");
+
+	uint64_t maxCompressedSize = getMaxCompressedSize(sourceSize);
+	int headerSize = getHeaderSize(maxCompressedSize);
+
+	// Even the smallest compressed data does not fit, but the stored data may
+	if (destinationSize < static_cast<size_t>(headerSize + MIN_COMPRESSED_DATA_SIZE))
+	{
+		return store(source, sourceSize, destination, destinationSize, compressedSize);
+	}
+
+	// Compute the maximum output end pointer
+	// We use this to determine whether we should store the data instead of compressing it
+	// If the destination is smaller than the maximum compressed size, the compression stops as soon as the output does not fit
+	uint8_t* maxOutputEnd = outputBuffer + static_cast<size_t>(std::min(maxCompressedSize, static_cast<uint64_t>(destinationSize)));
+
+	// Compress the data after the header
+	uint8_t* compressedDataBegin = outputBuffer + headerSize;
+	uint8_t* compressedDataEnd;
+
+	initialize();
+
+	// The fast levels and the fast decompression level have their own parsers, the other levels use the default one
+	if (level_ == COMPRESSION_LEVEL_FASTEST)
+	{
+		compressedDataEnd = compress<CompressionConfig<COMPRESSION_LEVEL_FASTEST> >(*hashChainMatchFinder_, 0, inputBuffer, sourceSize, 0, sourceSize, compressedDataBegin, maxOutputEnd);
+	}
+	else if (level_ == COMPRESSION_LEVEL_FAST)
+	{
+		compressedDataEnd = compress<CompressionConfig<COMPRESSION_LEVEL_FAST> >(*hashChainMatchFinder_, 0, inputBuffer, sourceSize, 0, sourceSize, compressedDataBegin, maxOutputEnd);
+	}
+	else if (level_ == COMPRESSION_LEVEL_FAST_DECOMPRESSION)
+	{
+		compressedDataEnd = compress<CompressionConfig<COMPRESSION_LEVEL_FAST_DECOMPRESSION> >(*dictionary_, 0, inputBuffer, sourceSize, 0, sourceSize, compressedDataBegin, maxOutputEnd);
+	}
+	else if (matchFinderType_ == MATCH_FINDER_SUFFIX_ARRAY && threadCount > 1)
+	{
+		compressedDataEnd = compress<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*pipelinedSuffixArrayMatchFinder_, longDistanceMatcher_, inputBuffer, sourceSize, 0, sourceSize, compressedDataBegin, maxOutputEnd);
+		pipelinedSuffixArrayMatchFinder_->stop();
+	}
+	else if (matchFinderType_ == MATCH_FINDER_SUFFIX_ARRAY)
+	{
+		compressedDataEnd = compress<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*suffixArrayMatchFinder_, longDistanceMatcher_, inputBuffer, sourceSize, 0, sourceSize, compressedDataBegin, maxOutputEnd);
+	}
+	else if (matchFinderType_ == MATCH_FINDER_HASH_CHAIN)
+	{
+		compressedDataEnd = compress<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*hashChainMatchFinder_, longDistanceMatcher_, inputBuffer, sourceSize, 0, sourceSize, compressedDataBegin, maxOutputEnd);
+	}
+	else if (threadCount > 1)
+	{
+		compressedDataEnd = compressSegments(inputBuffer, sourceSize, compressedDataBegin, maxOutputEnd);
+	}
+	else
+	{
+		compressedDataEnd = compress<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*dictionary_, longDistanceMatcher_, inputBuffer, sourceSize, 0, sourceSize, compressedDataBegin, maxOutputEnd);
+	}
+
+	// If the compressed data does not fit, store the data instead
+	if (compressedDataEnd == 0)
+	{
+		return store(source, sourceSize, destination, destinationSize, compressedSize);
+	}
+
+	assert(compressedDataEnd <= outputEnd);
+
+	// Done, compute the compressed size
+	compressedSize = compressedDataEnd - outputBuffer;
+
+	// Encode the header
+	Header header;
+	header.version = VERSION;
+	header.windowSizeLog = windowSizeLog_;
+	header.isStored = false;
+	header.uncompressedSize = sourceSize;
+	header.compressedSize = compressedSize;
+
+	encodeHeader(header, maxCompressedSize, outputBuffer);
+
+	// Return the compressed size
+	return RESULT_OK;
+}
+
+Result Compressor::findSequences(const void* source, size_t sourceSize, Sequence* sequences, size_t maxSequenceCount, size_t& sequenceCount)
+{
+	assert(source != 0);
+	assert(sequences != 0);
+
+	if (sourceSize == 0 || maxSequenceCount < getMaxSequenceCount(sourceSize))
+	{
+		return RESULT_ERROR_BUFFER_TOO_SMALL;
+	}
+
+	const uint8_t* inputBuffer = static_cast<const uint8_t*>(source);
+
+	// Parse the data like the compressor without segments
+	SequenceEncoder encoder;
+	encoder.begin(sequences, sequences + maxSequenceCount, windowSizeLog_);
+
+	bool isParsed;
+
+	initialize();
+
+	if (level_ == COMPRESSION_LEVEL_FASTEST)
+	{
+		isParsed = parse<CompressionConfig<COMPRESSION_LEVEL_FASTEST> >(*hashChainMatchFinder_, 0, inputBuffer, sourceSize, 0, sourceSize, encoder);
+	}
+	else if (level_ == COMPRESSION_LEVEL_FAST)
+	{
+		isParsed = parse<CompressionConfig<COMPRESSION_LEVEL_FAST> >(*hashChainMatchFinder_, 0, inputBuffer, sourceSize, 0, sourceSize, encoder);
+	}
+	else if (level_ == COMPRESSION_LEVEL_FAST_DECOMPRESSION)
+	{
+		isParsed = parse<CompressionConfig<COMPRESSION_LEVEL_FAST_DECOMPRESSION> >(*dictionary_, 0, inputBuffer, sourceSize, 0, sourceSize, encoder);
+	}
+	else if (matchFinderType_ == MATCH_FINDER_SUFFIX_ARRAY && threadCount_ > 1)
+	{
+		isParsed = parse<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*pipelinedSuffixArrayMatchFinder_, longDistanceMatcher_, inputBuffer, sourceSize, 0, sourceSize, encoder);
+		pipelinedSuffixArrayMatchFinder_->stop();
+	}
+	else if (matchFinderType_ == MATCH_FINDER_SUFFIX_ARRAY)
+	{
+		isParsed = parse<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*suffixArrayMatchFinder_, longDistanceMatcher_, inputBuffer, sourceSize, 0, sourceSize, encoder);
+	}
+	else if (matchFinderType_ == MATCH_FINDER_HASH_CHAIN)
+	{
+		isParsed = parse<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*hashChainMatchFinder_, longDistanceMatcher_, inputBuffer, sourceSize, 0, sourceSize, encoder);
+	}
+	else if (threadCount_ > 1)
+	{
+		isParsed = parse<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*pipelinedDictionary_, longDistanceMatcher_, inputBuffer, sourceSize, 0, sourceSize, encoder);
+		pipelinedDictionary_->stop();
+	}
+	else
+	{
+		isParsed = parse<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*dictionary_, longDistanceMatcher_, inputBuffer, sourceSize, 0, sourceSize, encoder);
+	}
+
+	if (!isParsed)
+	{
+		return RESULT_ERROR_BUFFER_TOO_SMALL;
+	}
+
+	sequenceCount = encoder.end() - sequences;
+	return RESULT_OK;
+}
+
+Result Compressor::compressSequences(const void* source, size_t sourceSize, const Sequence* sequences, size_t sequenceCount, void* destination, size_t destinationSize, size_t& compressedSize)
 {
 	assert(source != 0);
+	assert(sequences != 0);
 	assert(destination != 0);
 
 	if (sourceSize == 0)
@@ -35,94 +1129,338 @@ Result Compressor::compress(const void* source, size_t sourceSize, void* destina
 	}
 
 	uint64_t maxCompressedSize = getMaxCompressedSize(sourceSize);
-	if (destinationSize < maxCompressedSize)
+	int headerSize = getHeaderSize(maxCompressedSize);
+
+	if (destinationSize < static_cast<size_t>(headerSize + MIN_COMPRESSED_DATA_SIZE))
 	{
-		return RESULT_ERROR_BUFFER_TOO_SMALL;
+		return store(source, sourceSize, destination, destinationSize, compressedSize);
 	}
 
 	const uint8_t* inputBuffer = static_cast<const uint8_t*>(source);
 	uint8_t* outputBuffer = static_cast<uint8_t*>(destination);
-	uint8_t* outputEnd = outputBuffer + destinationSize;
-	assert((inputBuffer + sourceSize <= outputBuffer || inputBuffer >= outputEnd) && "The source and destination buffers must not overlap.");
+	uint8_t* maxOutputEnd = outputBuffer + static_cast<size_t>(std::min(maxCompressedSize, static_cast<uint64_t>(destinationSize)));
 
-	// Compute the maximum output end pointer
-	// We use this to determine whether we should store the data instead of compressing it
-	uint8_t* maxOutputEnd = outputBuffer + static_cast<size_t>(maxCompressedSize);
+	// Initialize the encoder after the header
+	Encoder encoder;
+	encoder.begin(outputBuffer + headerSize, maxOutputEnd, windowSizeLog_);
 
-	// Allocate the header
-	uint8_t* outputIterator = outputBuffer;
-	outputIterator += getHeaderSize(maxCompressedSize);
+	// The decoder requires literals in the tail of the block
+	size_t tailStart = (sourceSize > TAIL_LENGTH) ? sourceSize - TAIL_LENGTH : 0;
+	size_t windowSize = static_cast<size_t>(1) << windowSizeLog_;
 
-	// Initialize the dictionary
-	dictionary_.setBuffer(inputBuffer, sourceSize);
+	// The literals of consecutive sequences are encoded in a single run
+	const uint8_t* literalRun = inputBuffer;
+	size_t literalRunLength = 0;
+	size_t position = 0;
 
-	// Initialize the control word which contains the literal/match bits
-	// The highest bit of a control word is a guard bit, which marks the end of the bit list
-	// The guard bit simplifies and speeds up the decoding process, and it 
-	const int controlWordBitCount = WORD_SIZE * 8 - 1;
-	const uint32_t controlWordGuardBit = 1u << controlWordBitCount;
-	uint32_t controlWord = controlWordGuardBit;
-	int controlWordBit = 0;
+	for (size_t i = 0; i < sequenceCount; ++i)
+	{
+		const Sequence& sequence = sequences[i];
 
-	// Since we do not know the contents of the control words in advance, we allocate space for them and subsequently fill them with data as soon as we can
-	// This is necessary because the decoder must encounter a control word *before* the literals and matches it refers to
-	// We begin the compressed data with a control word
-	uint8_t* controlWordPointer = outputIterator;
-	outputIterator += WORD_SIZE;
+		if (sequence.literalLength > sourceSize - position || sequence.matchLength < 0 || static_cast<size_t>(sequence.matchLength) > sourceSize - position - sequence.literalLength)
+		{
+			return RESULT_ERROR_INVALID_SEQUENCES;
+		}
 
-	// The match located at the current inputIterator position
-	Match match;
+		if (literalRunLength == 0)
+		{
+			literalRun = inputBuffer + position;
+		}
 
-	// The match located at the next inputIterator position
-	// Initialize it to 'no match', because we are at the beginning of the inputIterator buffer
-	// A match with a length of 0 means that there is no match
-	Match nextMatch;
-	nextMatch.length = 0;
+		literalRunLength += sequence.literalLength;
+		position += sequence.literalLength;
 
-	// The dictionary matching look-ahead is 1 character, so set the dictionary position to 1
-	// We don't have to worry about getting matches beyond the inputIterator, because the dictionary ignores such requests
-	dictionary_.skip();
+		if (sequence.matchLength == 0)
+		{
+			continue;
+		}
 
-	// At each position, we select the best match to encode from a list of match candidates provided by the match finder
-	Match matchCandidates[MAX_MATCH_CANDIDATE_COUNT];
-	int matchCandidateCount;
+		if (sequence.matchLength < MIN_MATCH_LENGTH || sequence.offset <= 0 || static_cast<size_t>(sequence.offset) > position || static_cast<size_t>(sequence.offset) >= windowSize)
+		{
+			return RESULT_ERROR_INVALID_SEQUENCES;
+		}
 
-	// Iterate while there is still data left
-	while (dictionary_.position() - 1 < sourceSize)
+		// Matches must not reach into the tail of the block, the rest of such matches is encoded as literals
+		int matchLength = (position < tailStart) ? static_cast<int>(std::min(static_cast<size_t>(sequence.matchLength), tailStart - position)) : 0;
+
+		if (matchLength >= MIN_MATCH_LENGTH)
+		{
+			// Check whether the output is too large
+			if (!encoder.hasSpaceFor(literalRunLength, true))
+			{
+				return store(source, sourceSize, destination, destinationSize, compressedSize);
+			}
+
+			encoder.encodeLiterals(literalRun, literalRunLength);
+			literalRunLength = 0;
+
+			// Split the matches which are too long to be encoded, the parts after the first one have a repeated offset
+			Match match;
+			match.offset = sequence.offset;
+
+			for (int remainingLength = matchLength; remainingLength > 0; remainingLength -= match.length)
+			{
+				match.length = std::min(remainingLength, MAX_EXTENDED_MATCH_LENGTH);
+
+				if (remainingLength - match.length > 0 && remainingLength - match.length < MIN_MATCH_LENGTH)
+				{
+					match.length -= MIN_MATCH_LENGTH;
+				}
+
+				if (!encoder.hasSpaceFor(0, true))
+				{
+					return store(source, sourceSize, destination, destinationSize, compressedSize);
+				}
+
+				encoder.encodeMatch(match);
+			}
+
+			position += matchLength;
+		}
+		else
+		{
+			matchLength = 0;
+		}
+
+		if (sequence.matchLength > matchLength)
+		{
+			if (literalRunLength == 0)
+			{
+				literalRun = inputBuffer + position;
+			}
+
+			literalRunLength += sequence.matchLength - matchLength;
+			position += sequence.matchLength - matchLength;
+		}
+	}
+
+	if (position != sourceSize)
+	{
+		return RESULT_ERROR_INVALID_SEQUENCES;
+	}
+
+	// Encode the remaining literals
+	if (!encoder.hasSpaceFor(literalRunLength, false))
+	{
+		return store(source, sourceSize, destination, destinationSize, compressedSize);
+	}
+
+	encoder.encodeLiterals(literalRun, literalRunLength);
+
+	// Finish the compressed data
+	compressedSize = encoder.end() - outputBuffer;
+
+	// Encode the header
+	Header header;
+	header.version = VERSION;
+	header.windowSizeLog = windowSizeLog_;
+	header.isStored = false;
+	header.uncompressedSize = sourceSize;
+	header.compressedSize = compressedSize;
+
+	encodeHeader(header, maxCompressedSize, outputBuffer);
+
+	return RESULT_OK;
+}
+
+// Splits the buffer into segments and compresses them in parallel
+// Returns the end of the compressed data, or null if it does not fit into the destination
+uint8_t* Compressor::compressSegments(const uint8_t* buffer, size_t bufferLength, uint8_t* destination, uint8_t* destinationEnd)
+{
+	int segmentCount = getSegmentCount(bufferLength);
+
+	// If the block is too small to be split, find the matches and encode them on separate threads
+	if (segmentCount <= 1)
 	{
-		// Check whether the output is too large
-		// During each iteration, we may output up to 8 bytes (2 words), and the compressed stream ends with 4 dummy bytes
-		if (outputIterator + 2 * WORD_SIZE + TRAILING_DUMMY_SIZE > maxOutputEnd)
+		uint8_t* compressedDataEnd = compress<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*pipelinedDictionary_, longDistanceMatcher_, buffer, bufferLength, 0, bufferLength, destination, destinationEnd);
+		pipelinedDictionary_->stop();
+		return compressedDataEnd;
+	}
+
+	// Every segment needs space for at least a control word and the trailing dummy bytes
+	if (static_cast<size_t>(destinationEnd - destination) < segmentCount * static_cast<size_t>(MIN_COMPRESSED_DATA_SIZE))
+	{
+		return 0;
+	}
+
+	size_t segmentLength = (bufferLength + segmentCount - 1) / segmentCount;
+	initializeSegments(segmentCount);
+
+	// Compress the segments into separate buffers
+	SegmentJob jobs[MAX_THREAD_COUNT];
+	Thread threads[MAX_THREAD_COUNT];
+
+	for (int i = 0; i < segmentCount; ++i)
+	{
+		SegmentJob& job = jobs[i];
+
+		if (i == 0)
+		{
+			job.dictionary = dictionary_;
+			job.longDistanceMatcher = longDistanceMatcher_;
+		}
+		else
 		{
-			// Stop the compression and instead store
-			return store(source, sourceSize, destination, compressedSize);
+			job.dictionary = threadDictionaries_[i];
+			job.longDistanceMatcher = threadLongDistanceMatchers_[i];
 		}
 
-		// Check whether the control word must be flushed
-		if (controlWordBit == controlWordBitCount)
+		if (!longDistanceMatching_)
 		{
-			// Flush current control word
-			fastWrite(controlWordPointer, controlWord, WORD_SIZE);
+			job.longDistanceMatcher = 0;
+		}
+
+		job.compressor = this;
+		job.buffer = buffer;
+		job.bufferLength = bufferLength;
+		job.segmentStart = i * segmentLength;
+		job.segmentEnd = std::min(job.segmentStart + segmentLength, bufferLength);
+
+		// The segment must fit into the destination together with the previous segments, which are at least a control word long
+		size_t segmentLimit = static_cast<size_t>(destinationEnd - destination) - i * Encoder::CONTROL_WORD_SIZE;
+		job.outputSize = std::min(Encoder::getMaxLiteralsCodedSize(job.segmentEnd - job.segmentStart) + Encoder::CONTROL_WORD_SIZE + Encoder::MAX_MATCH_CODED_SIZE + Encoder::TRAILING_DUMMY_SIZE, segmentLimit);
+		job.output = new uint8_t[job.outputSize];
+	}
 
-			// New control word
-			controlWord = controlWordGuardBit;
-			controlWordBit = 0;
+	// The first segment is compressed on the current thread
+	for (int i = 1; i < segmentCount; ++i)
+	{
+		threads[i].start(compressSegment, &jobs[i]);
+	}
+
+	compressSegment(&jobs[0]);
+
+	for (int i = 1; i < segmentCount; ++i)
+	{
+		threads[i].join();
+	}
+
+	// Concatenate the compressed segments
+	uint8_t* outputIterator = destination;
+
+	for (int i = 0; i < segmentCount; ++i)
+	{
+		if (outputIterator != 0)
+		{
+			size_t segmentSize = (jobs[i].outputEnd != 0) ? (jobs[i].outputEnd - jobs[i].output) : 0;
 
-			controlWordPointer = outputIterator;
-			outputIterator += WORD_SIZE;
+			if (jobs[i].outputEnd != 0 && segmentSize <= static_cast<size_t>(destinationEnd - outputIterator))
+			{
+				memcpy(outputIterator, jobs[i].output, segmentSize);
+				outputIterator += segmentSize;
+			}
+			else
+			{
+				outputIterator = 0;
+			}
 		}
 
+		delete[] jobs[i].output;
+	}
+
+	return outputIterator;
+}
+
+void Compressor::compressSegment(void* job)
+{
+	SegmentJob* segmentJob = static_cast<SegmentJob*>(job);
+
+	segmentJob->outputEnd = segmentJob->compressor->compress<CompressionConfig<COMPRESSION_LEVEL_DEFAULT> >(*segmentJob->dictionary, segmentJob->longDistanceMatcher, segmentJob->buffer, segmentJob->bufferLength,
+		segmentJob->segmentStart, segmentJob->segmentEnd, segmentJob->output, segmentJob->output + segmentJob->outputSize);
+}
+
+// Compresses a segment of the buffer with the specified match finder and long-distance matcher (optional)
+// The segment is compressed as a continuation of the preceding segments, so the match finder is primed with the preceding window
+// Returns the end of the compressed data, or null if it does not fit into the destination
+template <class Config, class MatchFinder>
+uint8_t* Compressor::compress(MatchFinder& matchFinder, LongDistanceMatcher* longDistanceMatcher, const uint8_t* buffer, size_t bufferLength, size_t segmentStart, size_t segmentEnd,
+	uint8_t* destination, uint8_t* destinationEnd)
+{
+	Encoder encoder;
+
+	if (segmentStart == 0)
+	{
+		encoder.begin(destination, destinationEnd, windowSizeLog_);
+	}
+	else
+	{
+		encoder.beginSegment(destination, destinationEnd, windowSizeLog_);
+	}
+
+	if (!parse<Config>(matchFinder, longDistanceMatcher, buffer, bufferLength, segmentStart, segmentEnd, encoder))
+	{
+		return 0;
+	}
+
+	// Finish the compressed data
+	// Only the last segment ends with the trailing dummy bytes
+	return (segmentEnd == bufferLength) ? encoder.end() : encoder.endSegment();
+}
+
+// Parses a segment of the buffer into literals and matches, and passes them to the encoder
+// Returns false if the encoded segment does not fit into the destination of the encoder
+template <class Config, class MatchFinder, class SegmentEncoder>
+bool Compressor::parse(MatchFinder& matchFinder, LongDistanceMatcher* longDistanceMatcher, const uint8_t* buffer, size_t bufferLength, size_t segmentStart, size_t segmentEnd,
+	SegmentEncoder& encoder)
+{
+	bool isLastSegment = (segmentEnd == bufferLength);
+
+	// Matches must end within the segment, so the buffer is cut after the segment
+	// The match finders do not return matches which end in the tail of the buffer (see Dictionary)
+	size_t matchableBufferLength = isLastSegment ? bufferLength : segmentEnd + TAIL_LENGTH;
+
+	// Initialize the match finder, and prime it with the window preceding the segment
+	size_t windowSize = static_cast<size_t>(1) << matchFinder.windowSizeLog();
+	size_t primingStart = (segmentStart > windowSize) ? segmentStart - windowSize : 0;
+
+	matchFinder.setBuffer(buffer, matchableBufferLength);
+	matchFinder.jump(primingStart);
+
+	for (size_t i = primingStart; i < segmentStart; ++i)
+	{
+		matchFinder.skip();
+	}
+
+	if (longDistanceMatcher != 0)
+	{
+		size_t longDistanceWindowSize = static_cast<size_t>(1) << windowSizeLog_;
+		longDistanceMatcher->setBuffer(buffer, matchableBufferLength, (segmentStart > longDistanceWindowSize) ? segmentStart - longDistanceWindowSize : 0);
+	}
+
+	// The literals are not encoded immediately, because long literal runs are encoded with a single token
+	// We collect the consecutive literals in a run, which is encoded before the next match
+	const uint8_t* literalRun = buffer + segmentStart;
+	size_t literalRunLength = 0;
+
+	// The match located at the current inputIterator position
+	Match match;
+
+	// The match located at the next inputIterator position
+	// The dictionary matching look-ahead is 1 character, so find the match at the beginning of the segment, which also sets the dictionary position to the next character
+	// We don't have to worry about getting matches beyond the inputIterator, because the dictionary ignores such requests
+	// A match with a length of 0 means that there is no match
+	Match nextMatch = findNextMatch<Config>(matchFinder, longDistanceMatcher, buffer, matchableBufferLength, encoder);
+
+	// Iterate while there is still data left
+	while (matchFinder.position() - 1 < segmentEnd)
+	{
 		// The current match is the previous 'next' match
 		match = nextMatch;
 
 		// Find the best match at the next position
 		// The dictionary position is automatically incremented
-		matchCandidateCount = dictionary_.findMatches(matchCandidates);
-		nextMatch = getBestMatch(matchCandidates, matchCandidateCount);
+		nextMatch = findNextMatch<Config>(matchFinder, longDistanceMatcher, buffer, matchableBufferLength, encoder);
 
 		// If we have a match, do not immediately use it, because we may miss an even better match (lazy evaluation)
 		// If encoding a literal and the next match has a higher compression ratio than encoding the current match, discard the current match
-		if (match.length > 0 && (1 + nextMatch.length) * getMatchCodedSize(match) > match.length * (1 + getMatchCodedSize(nextMatch)))
+		if (Config::HAS_LAZY_MATCHING && match.length > 0 && (1 + nextMatch.length) * getMatchCost<Config>(match, encoder) > match.length * (1 + getMatchCost<Config>(nextMatch, encoder)))
+		{
+			match.length = 0;
+		}
+
+		// Incompressible data is encoded as long literal runs, which are decoded with a single copy (see Encoder)
+		// A match splits the run, so it must also save the code and the length of the next run, otherwise it is discarded
+		if (match.length > 0 && literalRunLength >= MIN_LITERAL_RUN_LENGTH && match.length <= getMatchCost<Config>(match, encoder) + LITERAL_RUN_BREAK_COST)
 		{
 			match.length = 0;
 		}
@@ -130,63 +1468,78 @@ Result Compressor::compress(const void* source, size_t sourceSize, void* destina
 		// Check whether we must encode a literal or a match
 		if (match.length == 0)
 		{
-			// Encode a literal (0 control word flag)
-			// In order to efficiently decode literals in runs, the literal bit (0) must differ from the guard bit (1)
-
+			// Append a literal to the literal run
 			// The current dictionary position is now two characters ahead of the literal to encode
-			assert(outputIterator + 1 <= outputEnd);
-			fastWrite(outputIterator, inputBuffer[dictionary_.position() - 2], 1);
-			++outputIterator;
+			if (literalRunLength == 0)
+			{
+				literalRun = buffer + matchFinder.position() - 2;
+			}
+
+			++literalRunLength;
+
+			// The space is checked only before the matches, so also check it periodically in long literal runs
+			// This stops the compression early if the destination is too small
+			if (literalRunLength % LITERAL_RUN_SPACE_CHECK_INTERVAL == 0 && !encoder.hasSpaceFor(literalRunLength, false))
+			{
+				return false;
+			}
 		}
 		else
 		{
-			// Encode a match (1 control word flag)
-			controlWord |= 1 << controlWordBit;
-
-			assert(outputIterator + WORD_SIZE <= outputEnd);
-			outputIterator += encodeMatch(match, outputIterator);
-			
-			// Skip the matched characters
-			for (int i = 0; i < match.length - 2; ++i)
+			// Check whether the output is too large
+			// We output the pending literals and a match, and the compressed stream ends with some dummy bytes
+			if (!encoder.hasSpaceFor(literalRunLength, true))
 			{
-				dictionary_.skip();
+				// Stop the compression
+				return false;
 			}
 
-			matchCandidateCount = dictionary_.findMatches(matchCandidates);
-			nextMatch = getBestMatch(matchCandidates, matchCandidateCount);
-		}
+			// Encode the pending literals and the match
+			encoder.encodeLiterals(literalRun, literalRunLength);
+			literalRunLength = 0;
 
-		// Next control word bit
-		++controlWordBit;
-	}
+			// The match finder does not return matches longer than the maximum length, so try to extend the match
+			if (match.length == MAX_MATCH_LENGTH)
+			{
+				match.length = getExtendedMatchLength(buffer, matchableBufferLength, matchFinder.position() - 2, match);
+			}
 
-	// Flush the control word
-	fastWrite(controlWordPointer, controlWord, WORD_SIZE);
+			encoder.encodeMatch(match);
+			
+			// Skip the matched characters
+			// Inside long matches, only every SKIP_STRIDE-th string is added to the match finder, except for the last ones
+			// This saves a lot of work, and most of the strings can still be found later
+			int skipCount = match.length - 2;
+			int sparseSkipCount = std::max(skipCount - Config::DENSE_SKIP_LENGTH, 0);
 
-	// Output trailing safety dummy bytes
-	// This reduces the number of necessary buffer checks during decoding
-	assert(outputIterator + TRAILING_DUMMY_SIZE <= outputEnd);
-	fastWrite(outputIterator, 0, TRAILING_DUMMY_SIZE);
-	outputIterator += TRAILING_DUMMY_SIZE;
+			for (int i = 0; i < sparseSkipCount; i += Config::SKIP_STRIDE)
+			{
+				matchFinder.skip();
+				matchFinder.jump(std::min(static_cast<int>(Config::SKIP_STRIDE), sparseSkipCount - i) - 1);
+			}
 
-	// Done, compute the compressed size
-	compressedSize = outputIterator - outputBuffer;
+			for (int i = sparseSkipCount; i < skipCount; ++i)
+			{
+				matchFinder.skip();
+			}
 
-	// Encode the header
-	Header header;
-	header.version = VERSION;
-	header.isStored = false;
-	header.uncompressedSize = sourceSize;
-	header.compressedSize = compressedSize;
+			nextMatch = findNextMatch<Config>(matchFinder, longDistanceMatcher, buffer, matchableBufferLength, encoder);
+		}
+	}
 
-	encodeHeader(header, maxCompressedSize, outputBuffer);
+	// Encode the remaining literals
+	if (!encoder.hasSpaceFor(literalRunLength, false))
+	{
+		return false;
+	}
 
-	// Return the compressed size
-	return RESULT_OK;
+	encoder.encodeLiterals(literalRun, literalRunLength);
+	return true;
 }
 
 // Store the source
-Result Compressor::store(const void* source, size_t sourceSize, void* destination, size_t& compressedSize)
+// If the stored data does not fit into the destination either, returns RESULT_ERROR_COMPRESSED_DATA_TOO_LARGE
+Result Compressor::store(const void* source, size_t sourceSize, void* destination, size_t destinationSize, size_t& compressedSize)
 {
 	uint8_t* outputBuffer = static_cast<uint8_t*>(destination);
 	uint8_t* outputIterator = outputBuffer;
@@ -195,11 +1548,17 @@ Result Compressor::store(const void* source, size_t sourceSize, void* destinatio
 	uint64_t maxCompressedSize = getMaxCompressedSize(sourceSize);
 	int headerSize = getHeaderSize(maxCompressedSize);
 
+	if (destinationSize < static_cast<size_t>(headerSize) || destinationSize - headerSize < sourceSize)
+	{
+		return RESULT_ERROR_COMPRESSED_DATA_TOO_LARGE;
+	}
+
 	compressedSize = headerSize + sourceSize;
 
 	Header header;
 
 	header.version = VERSION;
+	header.windowSizeLog = windowSizeLog_;
 	header.isStored = true;
 	header.uncompressedSize = sourceSize;
 	header.compressedSize = compressedSize;
@@ -213,8 +1572,44 @@ Result Compressor::store(const void* source, size_t sourceSize, void* destinatio
 	return RESULT_OK;
 }
 
-// Selects the best match from a list of match candidates provided by the match finder
-Match Compressor::getBestMatch(Match* matchCandidates, int matchCandidateCount)
+// Finds the best match at the current position of the match finder, and slides the match finder to the next position
+template <class Config, class MatchFinder, class SegmentEncoder>
+Match Compressor::findNextMatch(MatchFinder& matchFinder, LongDistanceMatcher* longDistanceMatcher, const uint8_t* buffer, size_t bufferLength, const SegmentEncoder& encoder)
+{
+	size_t position = matchFinder.position();
+
+	// We select the best match to encode from a list of match candidates provided by the match finder
+	// We also consider the match with the offset of the previous match, because it can be encoded more efficiently
+	Match matchCandidates[MAX_MATCH_CANDIDATE_COUNT];
+	int matchCandidateCount = matchFinder.findMatches(matchCandidates);
+	Match repeatMatch = getRepeatMatch(buffer, bufferLength, position, encoder.getRepeatOffset());
+	Match bestMatch = getBestMatch<Config>(matchCandidates, matchCandidateCount, repeatMatch, encoder);
+
+	// Long-distance matches are usually beyond the window of the dictionary
+	if (longDistanceMatcher != 0)
+	{
+		const LongDistanceMatcher::LongMatch& longMatch = longDistanceMatcher->findMatch(position);
+
+		if (longMatch.length > 0 && longMatch.position <= position)
+		{
+			// Matches with the maximum length are extended when encoded, so we do not have to handle longer matches here
+			Match match;
+			match.length = static_cast<int>(std::min(longMatch.position + longMatch.length - position, static_cast<size_t>(MAX_MATCH_LENGTH)));
+			match.offset = longMatch.offset;
+
+			if (match.length > bestMatch.length && match.length > getMatchCost<Config>(match, encoder))
+			{
+				bestMatch = match;
+			}
+		}
+	}
+
+	return bestMatch;
+}
+
+// Selects the best match from a list of match candidates provided by the match finder and the repeat match
+template <class Config, class SegmentEncoder>
+Match Compressor::getBestMatch(Match* matchCandidates, int matchCandidateCount, const Match& repeatMatch, const SegmentEncoder& encoder)
 {
 	Match bestMatch;
 	bestMatch.length = 0;
@@ -222,64 +1617,92 @@ Match Compressor::getBestMatch(Match* matchCandidates, int matchCandidateCount)
 	// Select the longest match which can be coded efficiently (coded size is less than the length)
 	for (int i = matchCandidateCount - 1; i >= 0; --i)
 	{
-		if (matchCandidates[i].length > getMatchCodedSize(matchCandidates[i]))
+		if (matchCandidates[i].length > getMatchCost<Config>(matchCandidates[i], encoder))
 		{
 			bestMatch = matchCandidates[i];
 			break;
 		}
 	}
+
+	// Prefer the repeat match if it is not shorter, because its offset is cheaper to encode
+	if (repeatMatch.length >= bestMatch.length && repeatMatch.length > getMatchCost<Config>(repeatMatch, encoder))
+	{
+		bestMatch = repeatMatch;
+	}
 	
 	return bestMatch;
 }
 
-int Compressor::encodeMatch(const Match& match, void* destination)
+// Returns the cost of a match in bytes, which is its coded size, plus its estimated decompression time with some levels
+// The decompression cost of the other levels is zero, so it is folded away
+template <class Config, class SegmentEncoder>
+int Compressor::getMatchCost(const Match& match, const SegmentEncoder& encoder)
 {
-	assert(match.length <= MAX_MATCH_LENGTH);
-	assert(match.length == 0 || match.offset < DICTIONARY_SIZE);
+	int cost = encoder.getMatchCodedSize(match) + Config::MATCH_DECODING_COST;
 
-	uint32_t word;
-	int size;
-
-	uint32_t lengthCode = static_cast<uint32_t>(match.length - MIN_MATCH_LENGTH);
-	uint32_t offsetCode = static_cast<uint32_t>(match.offset);
-
-	if (lengthCode == 0 && offsetCode < 64)
-	{
-		word = offsetCode << 2; // 00
-		size = 1;
-	}
-	else if (lengthCode == 0 && offsetCode < 16384)
+	if (match.offset < WORD_SIZE)
 	{
-		word = (offsetCode << 2) | 1; // 01
-		size = 2;
+		cost += Config::OVERLAPPING_MATCH_DECODING_COST;
 	}
-	else if (lengthCode < 16 && offsetCode < 1024)
+
+	if (match.offset >= (1 << Config::FAR_MATCH_OFFSET_LOG))
 	{
-		word = (offsetCode << 6) | (lengthCode << 2) | 2; // 10
-		size = 2;
+		cost += Config::FAR_MATCH_DECODING_COST;
 	}
-	else if (lengthCode < 32 && offsetCode < 65536)
+
+	return cost;
+}
+
+// Finds the match at the specified position with the specified offset
+// The returned match has a length of 0 if there is no such match
+Match Compressor::getRepeatMatch(const uint8_t* buffer, size_t bufferLength, size_t position, int offset)
+{
+	Match match;
+	match.length = 0;
+	match.offset = offset;
+
+	// Matches must not start and end in the tail of the buffer (see Dictionary)
+	// There is no repeat offset at the beginning of segments
+	if (offset == 0 || position < static_cast<size_t>(offset) || position + TAIL_LENGTH + MIN_MATCH_LENGTH >= bufferLength)
 	{
-		word = (offsetCode << 8) | (lengthCode << 3) | 3; // 11
-		size = 3;
+		return match;
 	}
-	else
+
+	int maxMatchLength = static_cast<int>(std::min(bufferLength - TAIL_LENGTH - position, static_cast<size_t>(MAX_MATCH_LENGTH)));
+
+	const uint8_t* string = buffer + position;
+	const uint8_t* matchString = string - offset;
+	int matchLength = 0;
+
+	while (matchLength < maxMatchLength && string[matchLength] == matchString[matchLength])
 	{
-		word = (offsetCode << 11) | (lengthCode << 3) | 7; // 111
-		size = 4;
+		++matchLength;
 	}
 
-	if (destination != 0)
+	if (matchLength >= MIN_MATCH_LENGTH)
 	{
-		fastWrite(destination, word, size);
+		match.length = matchLength;
 	}
 
-	return size;
+	return match;
 }
 
-int Compressor::getMatchCodedSize(const Match& match)
+// Returns the length of the match at the specified position, extended as far as possible beyond its current length
+int Compressor::getExtendedMatchLength(const uint8_t* buffer, size_t bufferLength, size_t position, const Match& match)
 {
-	return encodeMatch(match, 0);
+	// Matches must not end in the tail of the buffer (see Dictionary)
+	int maxMatchLength = static_cast<int>(std::min(bufferLength - TAIL_LENGTH - position, static_cast<size_t>(MAX_EXTENDED_MATCH_LENGTH)));
+
+	const uint8_t* string = buffer + position;
+	const uint8_t* matchString = string - match.offset;
+	int matchLength = match.length;
+
+	while (matchLength < maxMatchLength && string[matchLength] == matchString[matchLength])
+	{
+		++matchLength;
+	}
+
+	return matchLength;
 }
 
 int Compressor::getSizeCodedSize(uint64_t size)
@@ -304,7 +1727,8 @@ int Compressor::getSizeCodedSize(uint64_t size)
 
 int Compressor::getHeaderSize(uint64_t maxCompressedSize)
 {
-	return 1 + 2 * getSizeCodedSize(maxCompressedSize);
+	// The attribute byte, the window size byte, and the sizes
+	return 2 + 2 * getSizeCodedSize(maxCompressedSize);
 }
 
 void Compressor::encodeHeader(const Header& header, uint64_t maxCompressedSize, void* destination)
@@ -326,6 +1750,9 @@ void Compressor::encodeHeader(const Header& header, uint64_t maxCompressedSize,
 
 	*outputIterator++ = static_cast<uint8_t>(attributes);
 
+	// Encode the window size
+	*outputIterator++ = static_cast<uint8_t>(header.windowSizeLog);
+
 	// Encode the uncompressed and compressed sizes
 	switch (sizeCodedSize)
 	{
@@ -357,4 +1784,20 @@ uint64_t Compressor::getMaxCompressedSize(uint64_t size)
 	return getHeaderSize(UINT64_MAX) + size;
 }
 
+size_t Compressor::getMaxSequenceCount(size_t size)
+{
+	// Every sequence contains a match, except for the last one
+	return size / MIN_MATCH_LENGTH + 1;
+}
+
+Result compress(const void* source, size_t sourceSize, void* destination, size_t destinationSize, size_t& compressedSize)
+{
+	// Only one thread uses a compressor at a time, and it keeps its match finders when it is returned to the pool
+	PooledCompressor compressor;
+	Result result = compressor.get().compress(source, sourceSize, destination, destinationSize, compressedSize);
+	compressor.release();
+
+	return result;
+}
+
 } // namespace doboz
\ No newline at end of file
@@ -20,33 +20,393 @@
 
 #include "Common.h"
 #include "Dictionary.h"
+#include "HashChainMatchFinder.h"
+#include "Encoder.h"
+#include "SequenceEncoder.h"
 
 namespace doboz {
 
+// The compressor only holds pointers to these, so their headers (and the platform headers of the threads) are not included here
+namespace detail {
+
+class SuffixArrayMatchFinder;
+class LongDistanceMatcher;
+
+template <class MatchFinder>
+class PipelinedMatchFinder;
+
+} // namespace detail
+
+enum MatchFinderType
+{
+	MATCH_FINDER_BINARY_TREE, // fast, finds the longest matches in most cases
+	MATCH_FINDER_SUFFIX_ARRAY, // slow and needs more memory, but always finds the longest matches, uses up to 8 threads
+	MATCH_FINDER_HASH_CHAIN, // needs half as much memory as the binary tree, but finds shorter matches, uses a single thread
+};
+
+// Predefined sets of compression parameters, from the fastest to the best compression ratio, except for the last one
+enum CompressionLevel
+{
+	COMPRESSION_LEVEL_FASTEST, // small hash chain window, greedy parsing, most of the matched strings are not added to the match finder
+	COMPRESSION_LEVEL_FAST, // hash chain match finder with short chains
+	COMPRESSION_LEVEL_DEFAULT, // the default parameters
+	COMPRESSION_LEVEL_MAX, // suffix array match finder, which always finds the longest matches
+	COMPRESSION_LEVEL_FAST_DECOMPRESSION, // like the default level, but avoids matches which are slow to decompress at the cost of a slightly lower ratio
+};
+
+namespace detail {
+
+// Parameters of the compression levels
+// The parsing parameters are compile-time constants, so the parser is specialized for every level
+// Every level extends the default one or a similar level
+template <int level>
+struct CompressionConfig;
+
+template <>
+struct CompressionConfig<COMPRESSION_LEVEL_DEFAULT>
+{
+	static const MatchFinderType MATCH_FINDER_TYPE = MATCH_FINDER_BINARY_TREE;
+	static const int WINDOW_SIZE_LOG = DEFAULT_WINDOW_SIZE_LOG;
+	static const int MAX_CHAIN_LENGTH = HashChainMatchFinder::DEFAULT_MAX_CHAIN_LENGTH;
+
+	static const bool HAS_LAZY_MATCHING = true; // a match is discarded if the match at the next position is better
+	static const int DENSE_SKIP_LENGTH = MAX_MATCH_LENGTH; // all the strings in the end of a match are added to the match finder
+	static const int SKIP_STRIDE = 16; // before the end of the match, only every SKIP_STRIDE-th string is added
+
+	// The estimated decompression time of matches in bytes, which is added to their coded size when selecting the matches
+	static const int MATCH_DECODING_COST = 0; // every match
+	static const int OVERLAPPING_MATCH_DECODING_COST = 0; // matches with offsets less than the word size, which are copied byte by byte
+	static const int FAR_MATCH_DECODING_COST = 0; // matches with offsets of at least 2^FAR_MATCH_OFFSET_LOG, which usually miss the cache
+	static const int FAR_MATCH_OFFSET_LOG = MAX_WINDOW_SIZE_LOG;
+};
+
+template <>
+struct CompressionConfig<COMPRESSION_LEVEL_FAST> : CompressionConfig<COMPRESSION_LEVEL_DEFAULT>
+{
+	static const MatchFinderType MATCH_FINDER_TYPE = MATCH_FINDER_HASH_CHAIN;
+	static const int WINDOW_SIZE_LOG = 18;
+	static const int MAX_CHAIN_LENGTH = 8;
+
+	static const int DENSE_SKIP_LENGTH = 16;
+	static const int SKIP_STRIDE = 4;
+};
+
+template <>
+struct CompressionConfig<COMPRESSION_LEVEL_FASTEST> : CompressionConfig<COMPRESSION_LEVEL_FAST>
+{
+	static const int WINDOW_SIZE_LOG = 17;
+	static const int MAX_CHAIN_LENGTH = 2;
+
+	static const bool HAS_LAZY_MATCHING = false;
+	static const int DENSE_SKIP_LENGTH = 4;
+	static const int SKIP_STRIDE = 8;
+};
+
+template <>
+struct CompressionConfig<COMPRESSION_LEVEL_MAX> : CompressionConfig<COMPRESSION_LEVEL_DEFAULT>
+{
+	static const MatchFinderType MATCH_FINDER_TYPE = MATCH_FINDER_SUFFIX_ARRAY;
+};
+
+template <>
+struct CompressionConfig<COMPRESSION_LEVEL_FAST_DECOMPRESSION> : CompressionConfig<COMPRESSION_LEVEL_DEFAULT>
+{
+	static const int MATCH_DECODING_COST = 1;
+	static const int OVERLAPPING_MATCH_DECODING_COST = 4;
+	static const int FAR_MATCH_DECODING_COST = 1;
+	static const int FAR_MATCH_OFFSET_LOG = 16;
+};
+
+} // namespace detail
+
+// The maximum amount of memory in bytes used by a compressor
+struct MemoryBudget
+{
+	explicit MemoryBudget(size_t size)
+		: size(size)
+	{
+	}
+
+	size_t size;
+};
+
+// A compression speed in MiB/s (1024 * 1024 bytes per second, like the MB/s printed by the benchmark) on a single thread,
+// which the compressor tries to keep up with by selecting the level of every block
+struct ThroughputTarget
+{
+	explicit ThroughputTarget(double mebibytesPerSecond)
+		: mebibytesPerSecond(mebibytesPerSecond)
+	{
+	}
+
+	double mebibytesPerSecond;
+};
+
+// A compression ratio (the compressed size divided by the original size), which the compressor tries to reach with the fastest possible level
+struct RatioTarget
+{
+	explicit RatioTarget(double ratio)
+		: ratio(ratio)
+	{
+	}
+
+	double ratio;
+};
+
+// A part of a block of data which is not contiguous in memory, like an iovec
+struct SourceChunk
+{
+	const void* data;
+	size_t size;
+};
+
 class Compressor
 {
 public:
+	// The window size (the maximum match distance) is 2^windowSizeLog bytes
+	// The compressor allocates about 8 times the window size of memory
+	// With long-distance matching, long repeats are found in the whole window, but other matches only in the nearest 2 MB
+	// This requires much less memory with large windows
+	// With multiple threads, large blocks are split into segments, which are compressed in parallel by the binary tree match finder
+	// Every thread needs its own match finder, and the compressed size is about the same as with a single thread
+	// Blocks which cannot be split are compressed by two threads: the matches are found on one thread, and encoded on the other
+	// The suffix array match finder also builds the suffix arrays of large blocks on up to threadCount threads
+	explicit Compressor(int windowSizeLog = DEFAULT_WINDOW_SIZE_LOG, bool longDistanceMatching = false, MatchFinderType matchFinderType = MATCH_FINDER_BINARY_TREE, int threadCount = 1);
+
+	// Selects the parameters which give the best compression ratio within the memory budget (see getMemoryUsage)
+	// The window, the hash table and the match finder are selected, and only a single thread is used
+	// If the budget is very small, the window of the match finder may be smaller than the minimum window size
+	// If not even the smallest configuration fits, it is used anyway
+	explicit Compressor(const MemoryBudget& memoryBudget);
+
+	// Selects the parameters of a predefined compression level
+	// Multiple threads are used only by the default and the maximum levels
+	explicit Compressor(CompressionLevel level, int threadCount = 1);
+
+	// Selects the level of every block automatically, from the fastest to the default one, based on the previous blocks
+	// The speed and the compression ratio of every block are measured, and the level is changed by at most one after every block
+	// If the previous blocks have missed the target, a faster level is selected for a throughput target, or a better one for a ratio target
+	// Otherwise the level is changed in the other direction, so the neighbouring levels are mixed to reach the target on average
+	// Only a single thread is used, and the first block is compressed with the level which is the most likely to reach the target
+	explicit Compressor(const ThroughputTarget& target);
+	explicit Compressor(const RatioTarget& target);
+
+	~Compressor();
+
+#ifdef DOBOZ_HAS_RVALUE_REFERENCES
+	// Moving a compressor moves its match finders without copying them
+	// The moved-from compressor has the parameters of the other one, and creates new match finders when it is used again
+	Compressor(Compressor&& other);
+	Compressor& operator =(Compressor&& other);
+#endif
+
+	// Returns the level used for the next block, or the default level if the parameters are custom
+	CompressionLevel getLevel() const
+	{
+		return level_;
+	}
+
+	// Exchanges the parameters and the match finders of two compressors
+	void swap(Compressor& other);
+
+	// Allocates all the memory needed for compressing blocks up to the specified size, and touches every page of it
+	// Otherwise the memory is allocated by the first compression, which is much slower because of the page faults
+	// If the level is selected automatically, the memory of every selectable level is allocated
+	void reserve(size_t maxSourceSize);
+
+	// Allocates the memory needed for compressing blocks up to the specified size with a compression level, like reserve
+	// The level must be the level of the compressor, or any of the levels which can be selected automatically
+	void reserve(size_t maxSourceSize, CompressionLevel level);
+
+	// Returns the approximate amount of memory used for compressing blocks up to the specified size
+	// This includes the memory allocated by reserve, and the temporary memory allocated during the compression
+	// If the level is selected automatically, this includes the memory of every selectable level
+	// If the blocks are compressed from multiple chunks, this includes the buffer of the concatenated chunks
+	size_t getMemoryUsage(size_t maxSourceSize, bool hasChunks = false) const;
+
 	// Returns the maximum compressed size of any block of data with the specified size
-	// This function should be used to determine the size of the compression destination buffer
+	// This function should be used to determine the size of the compression destination buffer, which is always large enough
 	static uint64_t getMaxCompressedSize(uint64_t size);
 
 	// Compresses a block of data
 	// The source and destination buffers must not overlap and their size must be greater than 0
+	// The destination may be smaller than the maximum compressed size, then the compression stops as soon as the compressed data does not fit
+	// In that case RESULT_ERROR_COMPRESSED_DATA_TOO_LARGE is returned, and the contents of the destination are undefined
 	// This operation is memory safe
 	// On success, returns RESULT_OK and outputs the compressed size
 	Result compress(const void* source, size_t sourceSize, void* destination, size_t destinationSize, size_t& compressedSize);
 
+	// Compresses a block of data which consists of multiple chunks, with the same result as compressing the concatenated chunks
+	// The matches may cross the chunk boundaries
+	// The match finders need contiguous data, so multiple chunks are still copied once, into a buffer of the compressor instead of a buffer of the caller
+	// The buffer grows to the largest block and it is kept for the next blocks, so it is reallocated only when a larger block arrives (see getMemoryUsage)
+	// The size of the destination should be the maximum compressed size of the total size of the chunks
+	Result compress(const SourceChunk* chunks, size_t chunkCount, void* destination, size_t destinationSize, size_t& compressedSize);
+
+	// Quickly estimates the compression ratio (the compressed size divided by the original size) of a block of data, without compressing it
+	// At most 64 short samples of the block are parsed, using a small hash table which indexes a fraction of the preceding positions
+	// The estimate is rough: for blocks of at least 64 KB of binary, text and mixed test data, it was within 7 percentage points of the actual ratio on average,
+	// but individual blocks were off by up to 17 points, and very redundant structured data was estimated up to 13 points lower
+	// Blocks of 4 KB are sampled only once, so their estimates were off by up to 63 points, and only their average is meaningful
+	// The hash table indexes at most a window of data (up to 512 KB), and it is included in getMemoryUsage
+	// It is allocated by reserve or by the first call, and it is reused without clearing it
+	double estimate(const void* source, size_t sourceSize);
+
+	// Compresses a batch of blocks independently, one after the other on the current thread
+	// This is much faster than compressing many small blocks with multiple threads
+	// On success, returns RESULT_OK and outputs the compressed size of every block, otherwise returns the result of the first failed block
+	Result compressBatch(const void* const* sources, const size_t* sourceSizes, void* const* destinations, const size_t* destinationSizes, size_t* compressedSizes, size_t count);
+
+	// Returns the maximum number of sequences of any block of data with the specified size
+	// This function should be used to determine the size of the sequence array
+	static size_t getMaxSequenceCount(size_t size);
+
+	// Parses a block of data into sequences of literals and matches, the same way as it would be compressed, but without encoding it
+	// The literals are not copied, they are the bytes of the source between the matches
+	// The last sequence contains only the remaining literals
+	// On success, returns RESULT_OK and outputs the number of sequences
+	Result findSequences(const void* source, size_t sourceSize, Sequence* sequences, size_t maxSequenceCount, size_t& sequenceCount);
+
+	// Compresses a block of data parsed into sequences (e.g. by findSequences or an external match finder)
+	// The sequences must cover the whole source, and their match offsets must be less than the window size
+	// Matches which end in the last few bytes of the block are encoded as literals, and very long matches are split
+	// The destination may be smaller than the maximum compressed size, like with compress
+	// On success, returns RESULT_OK and outputs the compressed size
+	Result compressSequences(const void* source, size_t sourceSize, const Sequence* sequences, size_t sequenceCount, void* destination, size_t destinationSize, size_t& compressedSize);
+
+	static const int MAX_THREAD_COUNT = 64;
+
 private:
-	detail::Dictionary dictionary_;
+	static const int LITERAL_RUN_BREAK_COST = 2; // the size of a literal run code with a short run length
+	static const int LITERAL_RUN_SPACE_CHECK_INTERVAL = 4096;
+	static const int ESTIMATION_MIN_HASH_TABLE_SIZE_LOG = 8;
+	static const int ESTIMATION_MAX_HASH_TABLE_SIZE_LOG = 16;
+	static const int ESTIMATION_INDEX_STRIDE_LOG = 3;
+	static const int ESTIMATION_INDEX_STRIDE = 1 << ESTIMATION_INDEX_STRIDE_LOG; // every ESTIMATION_INDEX_STRIDE-th position is indexed between the samples
+	static const int ESTIMATION_SAMPLE_LENGTH = 256;
+	static const int ESTIMATION_SAMPLE_INTERVAL = 4096; // the minimum distance of the samples
+	static const int ESTIMATION_MAX_SAMPLE_COUNT = 64; // larger blocks are sampled more sparsely
+	static const int ESTIMATION_MAX_SAMPLE_OVERRUN = 1024; // the matches may extend this far after the end of a sample
+	static const int MIN_COMPRESSED_DATA_SIZE = detail::Encoder::CONTROL_WORD_SIZE + detail::Encoder::TRAILING_DUMMY_SIZE; // a control word and the trailing dummy bytes
+	static const int MIN_SEGMENT_LENGTH_WINDOW_RATIO = 4; // priming the match finder of a segment with the preceding window adds at most a quarter of its work, and 1 MB blocks can still be split into 4 segments with a 64 KB window
+	static const int MAX_TUNED_LEVEL = COMPRESSION_LEVEL_DEFAULT; // the levels from the fastest to the default one are selected automatically
+
+	enum TuningTarget
+	{
+		TUNING_TARGET_NONE,
+		TUNING_TARGET_THROUGHPUT,
+		TUNING_TARGET_RATIO,
+	};
+
+	// A segment of the block compressed by a thread
+	struct SegmentJob
+	{
+		Compressor* compressor;
+		detail::Dictionary* dictionary;
+		detail::LongDistanceMatcher* longDistanceMatcher;
+
+		const uint8_t* buffer;
+		size_t bufferLength;
+		size_t segmentStart;
+		size_t segmentEnd;
+
+		uint8_t* output;
+		uint8_t* outputEnd; // the end of the compressed segment, or null if it does not fit into the output buffer
+		size_t outputSize;
+	};
+
+	int windowSizeLog_;
+	bool longDistanceMatching_;
+	MatchFinderType matchFinderType_;
+	int threadCount_;
+	int matchFinderWindowSizeLog_; // may be smaller than the window of the encoding format
+	int hashTableSizeLog_;
+	int maxChainLength_;
+	CompressionLevel level_; // the level whose parser is used, the default one with custom parameters
+
+	// Automatic level selection
+	TuningTarget tuningTarget_;
+	double tuningTargetValue_; // bytes per second or the compression ratio
+	double tuningDebt_; // how much the previous blocks have missed the target in total, in seconds or bytes
+
+	// The match finders, created when first needed
+	size_t reservedSourceSize_; // the match finders of every automatically selected level are reserved for blocks up to this size
+	detail::Dictionary* dictionary_;
+	detail::SuffixArrayMatchFinder* suffixArrayMatchFinder_;
+	detail::HashChainMatchFinder* hashChainMatchFinder_;
+	detail::LongDistanceMatcher* longDistanceMatcher_;
+
+	detail::PipelinedMatchFinder<detail::Dictionary>* pipelinedDictionary_;
+	detail::PipelinedMatchFinder<detail::SuffixArrayMatchFinder>* pipelinedSuffixArrayMatchFinder_;
+
+	// The match finders of the additional threads, created when first needed
+	detail::Dictionary* threadDictionaries_[MAX_THREAD_COUNT];
+	detail::LongDistanceMatcher* threadLongDistanceMatchers_[MAX_THREAD_COUNT];
+
+	// The hash table of the estimation, allocated by reserve or when first needed
+	// Its entries are positions offset by estimationBase_, so the entries of the previous blocks are less than the base, and they are ignored
+	size_t* estimationHashTable_;
+	size_t estimationBase_;
+
+	// The concatenated chunks of the last block, allocated when first needed
+	uint8_t* gatherBuffer_;
+	size_t gatherBufferSize_;
+
+	void setLevel(CompressionLevel level);
+	template <class Config>
+	void setLevel(CompressionLevel level);
+	void setTunedLevel(CompressionLevel level);
+	static int getTunedHashChainWindowSizeLog();
+
+	void reset();
+	void initialize();
+	void initializeSegments(int segmentCount);
+	void reserveMatchFinders(size_t maxSourceSize);
+	void reserveEstimation();
+	size_t getMatchFinderMemoryUsage(MatchFinderType matchFinderType, int matchFinderWindowSizeLog, int threadCount, size_t maxSourceSize) const;
+	int getEstimationHashTableSizeLog() const;
+
+	int getLevelThreadCount(CompressionLevel level) const;
+	int getSegmentCount(size_t bufferLength) const;
+
+	Result compress(const void* source, size_t sourceSize, void* destination, size_t destinationSize, size_t& compressedSize, int threadCount);
+	Result compressTuned(const void* source, size_t sourceSize, void* destination, size_t destinationSize, size_t& compressedSize);
+
+	static double getEstimatedLiteralsCodedSize(size_t count);
 
 	static int getSizeCodedSize(uint64_t size);
 	static int getHeaderSize(uint64_t maxCompressedSize);
 
-	Result store(const void* source, size_t sourceSize, void* destination, size_t& compressedSize);
-	detail::Match getBestMatch(detail::Match* matchCandidates, int matchCandidateCount);
-	int encodeMatch(const detail::Match& match, void* destination);
-	int getMatchCodedSize(const detail::Match& match);
+	uint8_t* compressSegments(const uint8_t* buffer, size_t bufferLength, uint8_t* destination, uint8_t* destinationEnd);
+	static void compressSegment(void* job);
+
+	template <class Config, class MatchFinder>
+	uint8_t* compress(MatchFinder& matchFinder, detail::LongDistanceMatcher* longDistanceMatcher, const uint8_t* buffer, size_t bufferLength, size_t segmentStart, size_t segmentEnd, uint8_t* destination, uint8_t* destinationEnd);
+
+	template <class Config, class MatchFinder, class SegmentEncoder>
+	bool parse(MatchFinder& matchFinder, detail::LongDistanceMatcher* longDistanceMatcher, const uint8_t* buffer, size_t bufferLength, size_t segmentStart, size_t segmentEnd, SegmentEncoder& encoder);
+
+	Result store(const void* source, size_t sourceSize, void* destination, size_t destinationSize, size_t& compressedSize);
+
+	template <class Config, class MatchFinder, class SegmentEncoder>
+	detail::Match findNextMatch(MatchFinder& matchFinder, detail::LongDistanceMatcher* longDistanceMatcher, const uint8_t* buffer, size_t bufferLength, const SegmentEncoder& encoder);
+	template <class Config, class SegmentEncoder>
+	detail::Match getBestMatch(detail::Match* matchCandidates, int matchCandidateCount, const detail::Match& repeatMatch, const SegmentEncoder& encoder);
+	template <class Config, class SegmentEncoder>
+	static int getMatchCost(const detail::Match& match, const SegmentEncoder& encoder);
+	static detail::Match getRepeatMatch(const uint8_t* buffer, size_t bufferLength, size_t position, int offset);
+	static int getExtendedMatchLength(const uint8_t* buffer, size_t bufferLength, size_t position, const detail::Match& match);
 	void encodeHeader(const detail::Header& header, uint64_t maxCompressedSize, void* destination);
+
+	// Non-copyable
+	Compressor(const Compressor&);
+	Compressor& operator =(const Compressor&);
 };
 
+// Compresses a block of data with the default parameters, like Compressor::compress
+// This function can be called from multiple threads at the same time
+// The compressors are kept in a shared pool and reused, so the match finders are allocated only when the number of concurrent calls grows
+// At most 4 unused compressors are kept in the pool
+Result compress(const void* source, size_t sourceSize, void* destination, size_t destinationSize, size_t& compressedSize);
+
 } // namespace doboz
\ No newline at end of file
@@ -17,12 +17,142 @@
  */
 
 #include <cstring>
+#include <algorithm>
 #include "Decompressor.h"
+#include "Thread.h"
 
 namespace doboz {
 
+namespace detail {
+
+// Threads which run the same function in parallel, and then wait until they are started again
+// The current thread runs the function too, so the pool has one thread less than the number of parallel calls
+class DecompressionThreadPool
+{
+public:
+	DecompressionThreadPool()
+		: threadCount_(0),
+		  isExiting_(false)
+	{
+	}
+
+	~DecompressionThreadPool()
+	{
+		isExiting_ = true;
+
+		for (int i = 0; i < threadCount_; ++i)
+		{
+			workers_[i]->startEvent.set();
+			workers_[i]->thread.join();
+			delete workers_[i];
+		}
+	}
+
+	// Runs the function with the argument on the specified number of threads (including the current one), and waits for all of them to finish
+	// If there are not enough threads and some cannot be created, the function runs on fewer threads
+	void run(Thread::Function function, void* argument, int threadCount)
+	{
+		assert(threadCount >= 1 && threadCount <= Decompressor::MAX_THREAD_COUNT);
+
+		while (threadCount_ < threadCount - 1)
+		{
+			Worker* worker = new Worker(this);
+			if (!worker->thread.tryStart(work, worker))
+			{
+				delete worker;
+				break;
+			}
+
+			workers_[threadCount_++] = worker;
+		}
+
+		int workerCount = std::min(threadCount - 1, threadCount_);
+
+		// The events also make the argument visible to the workers, and the results of the workers visible to the current thread
+		function_ = function;
+		argument_ = argument;
+
+		for (int i = 0; i < workerCount; ++i)
+		{
+			workers_[i]->startEvent.set();
+		}
+
+		function(argument);
+
+		for (int i = 0; i < workerCount; ++i)
+		{
+			workers_[i]->finishedEvent.wait();
+		}
+	}
+
+private:
+	struct Worker
+	{
+		explicit Worker(DecompressionThreadPool* pool)
+			: pool(pool)
+		{
+		}
+
+		DecompressionThreadPool* pool;
+		Thread thread;
+		Event startEvent;
+		Event finishedEvent;
+	};
+
+	Worker* workers_[Decompressor::MAX_THREAD_COUNT];
+	int threadCount_;
+
+	Thread::Function function_;
+	void* argument_;
+	bool isExiting_; // set before the last start, which is seen through the event
+
+	static void work(void* argument)
+	{
+		Worker* worker = static_cast<Worker*>(argument);
+
+		for (; ;)
+		{
+			worker->startEvent.wait();
+
+			if (worker->pool->isExiting_)
+			{
+				break;
+			}
+
+			worker->pool->function_(worker->pool->argument_);
+			worker->finishedEvent.set();
+		}
+	}
+
+	// Non-copyable
+	DecompressionThreadPool(const DecompressionThreadPool&);
+	DecompressionThreadPool& operator =(const DecompressionThreadPool&);
+};
+
+} // namespace detail
+
 using namespace detail;
 
+Decompressor::Decompressor()
+	: threadPool_(0)
+{
+}
+
+Decompressor::~Decompressor()
+{
+	delete threadPool_;
+}
+
+Decompressor::Decompressor(const Decompressor& /*other*/)
+	: threadPool_(0)
+{
+}
+
+Decompressor& Decompressor::operator =(const Decompressor& /*other*/)
+{
+	return *this;
+}
+
 Result Decompressor::decompress(const void* source, size_t sourceSize, void* destination, size_t destinationSize)
 {
 	assert(source != 0);
@@ -32,7 +162,6 @@ Result Decompressor::decompress(const void* source, size_t sourceSize, void* des
 	const uint8_t* inputIterator = inputBuffer;
 
 	uint8_t* outputBuffer = static_cast<uint8_t*>(destination);
-	uint8_t* outputIterator = outputBuffer;
 
 	assert((inputBuffer + sourceSize <= outputBuffer || inputBuffer >= outputBuffer + destinationSize) &&
 		"The source and destination buffers must not overlap.");
@@ -49,7 +178,7 @@ Result Decompressor::decompress(const void* source, size_t sourceSize, void* des
 
 	inputIterator += headerSize;
 
-	if (header.version != VERSION)
+	if (header.version > VERSION)
 	{
 		return RESULT_ERROR_UNSUPPORTED_VERSION;
 	}
@@ -72,20 +201,132 @@ Result Decompressor::decompress(const void* source, size_t sourceSize, void* des
 	const uint8_t* inputEnd = inputBuffer + static_cast<size_t>(header.compressedSize);
 	uint8_t* outputEnd = outputBuffer + uncompressedSize;
 
+	// Decode the data with the decoder of the format version
+	// Older versions are still supported
+	switch (header.version)
+	{
+	case 0:
+		return decodeData<Format<0> >(inputIterator, inputEnd, outputBuffer, outputEnd, header.windowSizeLog);
+
+	case 1:
+		return decodeData<Format<1> >(inputIterator, inputEnd, outputBuffer, outputEnd, header.windowSizeLog);
+
+	case 2:
+		return decodeData<Format<2> >(inputIterator, inputEnd, outputBuffer, outputEnd, header.windowSizeLog);
+
+	case 3:
+		return decodeData<Format<3> >(inputIterator, inputEnd, outputBuffer, outputEnd, header.windowSizeLog);
+
+	case 4:
+		return decodeData<Format<4> >(inputIterator, inputEnd, outputBuffer, outputEnd, header.windowSizeLog);
+
+	case 5:
+		return decodeData<Format<5> >(inputIterator, inputEnd, outputBuffer, outputEnd, header.windowSizeLog);
+
+	default:
+		return RESULT_ERROR_UNSUPPORTED_VERSION;
+	}
+}
+
+Result Decompressor::decompressBatch(const void* const* sources, const size_t* sourceSizes, void* const* destinations, const size_t* destinationSizes, Result* results, size_t count, int threadCount)
+{
+	assert(sources != 0 || count == 0);
+	assert(threadCount >= 0 && threadCount <= MAX_THREAD_COUNT);
+
+	if (threadCount == 0)
+	{
+		threadCount = std::min(Thread::getProcessorCount(), static_cast<int>(MAX_THREAD_COUNT));
+	}
+
+	threadCount = static_cast<int>(std::min(static_cast<size_t>(threadCount), count));
+
+	BatchJob job;
+	job.decompressor = this;
+	job.sources = sources;
+	job.sourceSizes = sourceSizes;
+	job.destinations = destinations;
+	job.destinationSizes = destinationSizes;
+	job.results = results;
+	job.count = count;
+	atomicStore(job.nextIndex, static_cast<size_t>(0));
+
+	// A single thread needs no pool
+	if (threadCount <= 1)
+	{
+		decompressBatchBlocks(&job);
+	}
+	else
+	{
+		if (threadPool_ == 0)
+		{
+			threadPool_ = new DecompressionThreadPool();
+		}
+
+		threadPool_->run(decompressBatchBlocks, &job, threadCount);
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (results[i] != RESULT_OK)
+		{
+			return results[i];
+		}
+	}
+
+	return RESULT_OK;
+}
+
+// Decompresses the blocks of a batch until there are no more left
+void Decompressor::decompressBatchBlocks(void* job)
+{
+	BatchJob* batchJob = static_cast<BatchJob*>(job);
+
+	for (; ;)
+	{
+		size_t i = atomicFetchAdd(batchJob->nextIndex, 1);
+
+		if (i >= batchJob->count)
+		{
+			break;
+		}
+
+		batchJob->results[i] = batchJob->decompressor->decompress(batchJob->sources[i], batchJob->sourceSizes[i], batchJob->destinations[i], batchJob->destinationSizes[i]);
+	}
+}
+
+// Decodes the compressed literals and matches following the header
+template <class DataFormat>
+Result Decompressor::decodeData(const uint8_t* inputIterator, const uint8_t* inputEnd, uint8_t* outputBuffer, uint8_t* outputEnd, int windowSizeLog)
+{
+	typedef typename DataFormat::ControlWord ControlWord;
+
+	// The maximum number of bytes read at once: 8 literals or a match code
+	const int maxTokenSize = (DataFormat::MAX_MATCH_CODED_SIZE > 2 * WORD_SIZE) ? DataFormat::MAX_MATCH_CODED_SIZE : 2 * WORD_SIZE;
+
+	// The number of high offset bytes following the 4-byte match codes
+	const int offsetExtensionSize = std::max(windowSizeLog - LONG_MATCH_CODE_OFFSET_BIT_COUNT + 7, 0) / 8;
+
+	uint8_t* outputIterator = outputBuffer;
+	size_t uncompressedSize = outputEnd - outputBuffer;
+
 	// Compute pointer to the first byte of the output 'tail'
 	// Fast write operations can be used only before the tail, because those may write beyond the end of the output buffer
 	uint8_t* outputTail = (uncompressedSize > TAIL_LENGTH) ? (outputEnd - TAIL_LENGTH) : outputBuffer;
 
 	// Initialize the control word to 'empty'
-	uint32_t controlWord = 1;
+	ControlWord controlWord = 1;
+
+	// The offset of the previous match
+	int lastOffset = INITIAL_REPEAT_OFFSET;
 
 	// Decoding loop
-	for (; ;)
+	// Literals and matches are decoded using fast read/write operations until we reach the tail
+	while (outputIterator < outputTail)
 	{
 		// Check whether there is enough data left in the input buffer
-		// In order to decode the next literal/match, we have to read up to 8 bytes (2 words)
-		// Thanks to the trailing dummy, there must be at least 8 remaining input bytes
-		if (inputIterator + 2 * WORD_SIZE > inputEnd)
+		// In order to decode the next literal/match, we have to read a control word and up to maxTokenSize bytes
+		// Thanks to the trailing dummy, there must be enough remaining input bytes before the tail
+		if (inputIterator + DataFormat::CONTROL_WORD_SIZE + maxTokenSize > inputEnd)
 		{
 			return RESULT_ERROR_CORRUPTED_DATA;
 		}
@@ -93,71 +334,82 @@ Result Decompressor::decompress(const void* source, size_t sourceSize, void* des
 		// Check whether we must read a control word
 		if (controlWord == 1)
 		{
-			assert(inputIterator + WORD_SIZE <= inputEnd);
-			controlWord = fastRead(inputIterator, WORD_SIZE);
-			inputIterator += WORD_SIZE;
+			assert(inputIterator + DataFormat::CONTROL_WORD_SIZE <= inputEnd);
+			controlWord = fastReadWord<ControlWord>(inputIterator);
+			inputIterator += DataFormat::CONTROL_WORD_SIZE;
 		}
 
 		// Detect whether it's a literal or a match
 		if ((controlWord & 1) == 0)
 		{
 			// It's a literal
+			// We copy literals in runs of up to 8 because it's faster than copying one by one
+
+			// Copy implicitly 8 literals regardless of the run length
+			// We are before the tail, so we can safely use fast writing operations
+			assert(inputIterator + 2 * WORD_SIZE <= inputEnd);
+			assert(outputIterator + 2 * WORD_SIZE <= outputEnd);
+			fastWriteWord(outputIterator, fastReadWord<uint64_t>(inputIterator));
 
-			// If we are before the tail, we can safely use fast writing operations
-			if (outputIterator < outputTail)
+			// Get the run length using a lookup table: the number of trailing literal (0) bits in the lowest byte of the control word
+			static const int8_t literalRunLengthTable[256] =
 			{
-				// We copy literals in runs of up to 4 because it's faster than copying one by one
+			8, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			7, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+			4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+			};
+
+			int runLength = literalRunLengthTable[static_cast<uint32_t>(controlWord) & 0xff];
+
+			// Advance the inputBuffer and outputBuffer pointers with the run length
+			inputIterator += runLength;
+			outputIterator += runLength;
+
+			// Consume as much control word bits as the run length
+			controlWord >>= runLength;
+		}
+		else if (DataFormat::HAS_LITERAL_RUNS && *inputIterator == LITERAL_RUN_CODE)
+		{
+			// It's a literal run
 
-				// Copy implicitly 4 literals regardless of the run length
-				assert(inputIterator + WORD_SIZE <= inputEnd);
-				assert(outputIterator + WORD_SIZE <= outputEnd);
-				fastWrite(outputIterator, fastRead(inputIterator, WORD_SIZE), WORD_SIZE);
+			// Decode the run length
+			uint32_t runLength;
+			int runLengthSize = decodeVarInt(runLength, inputIterator + 1);
 
-				// Get the run length using a lookup table
-				static const int8_t literalRunLengthTable[16] = {4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0};
-				int runLength = literalRunLengthTable[controlWord & 0xf];
+			if (runLengthSize == 0)
+			{
+				return RESULT_ERROR_CORRUPTED_DATA;
+			}
 
-				// Advance the inputBuffer and outputBuffer pointers with the run length
-				inputIterator += runLength;
-				outputIterator += runLength;
+			inputIterator += 1 + runLengthSize;
 
-				// Consume as much control word bits as the run length
-				controlWord >>= runLength;
-			}
-			else
+			// Check whether the run is out of range
+			if (runLength > static_cast<size_t>(inputEnd - inputIterator) || runLength > static_cast<size_t>(outputEnd - outputIterator))
 			{
-				// We have reached the tail, we cannot output literals in runs anymore
-				// Output all remaining literals
-				while (outputIterator < outputEnd)
-				{
-					// Check whether there is enough data left in the input buffer
-					// In order to decode the next literal, we have to read up to 5 bytes
-					if (inputIterator + WORD_SIZE + 1 > inputEnd)
-					{
-						return RESULT_ERROR_CORRUPTED_DATA;
-					}
-
-					// Check whether we must read a control word
-					if (controlWord == 1)
-					{
-						assert(inputIterator + WORD_SIZE <= inputEnd);
-						controlWord = fastRead(inputIterator, WORD_SIZE);
-						inputIterator += WORD_SIZE;
-					}
-
-					// Output one literal
-					// We cannot use fast read/write functions
-					assert(inputIterator + 1 <= inputEnd);
-					assert(outputIterator + 1 <= outputEnd);
-					*outputIterator++ = *inputIterator++;
-
-					// Next control word bit
-					controlWord >>= 1;
-				}
-
-				// Done
-				return RESULT_OK;
+				return RESULT_ERROR_CORRUPTED_DATA;
 			}
+
+			// Copy the literals at once
+			memcpy(outputIterator, inputIterator, runLength);
+
+			inputIterator += runLength;
+			outputIterator += runLength;
+
+			// Next control word bit
+			controlWord >>= 1;
 		}
 		else
 		{
@@ -166,7 +418,45 @@ Result Decompressor::decompress(const void* source, size_t sourceSize, void* des
 			// Decode the match
 			assert(inputIterator + WORD_SIZE <= inputEnd);
 			Match match;
-			inputIterator += decodeMatch(match, inputIterator);
+			int matchCodeSize = decodeMatch(match, inputIterator);
+			inputIterator += matchCodeSize;
+
+			// With windows larger than 2 MB, the 4-byte match codes are followed by the high bits of the offset
+			if (DataFormat::HAS_WIDE_OFFSETS && matchCodeSize == WORD_SIZE)
+			{
+				for (int i = 0; i < offsetExtensionSize; ++i)
+				{
+					match.offset |= static_cast<int>(*inputIterator++) << (LONG_MATCH_CODE_OFFSET_BIT_COUNT + 8 * i);
+				}
+			}
+
+			// The maximum length code is followed by a length extension
+			// Thanks to the trailing dummy, the extension is within the input buffer
+			if (DataFormat::HAS_LONG_MATCHES && match.length == MAX_MATCH_LENGTH)
+			{
+				assert(inputIterator + MAX_VAR_INT_SIZE <= inputEnd);
+				uint32_t lengthExtension;
+				int lengthExtensionSize = decodeVarInt(lengthExtension, inputIterator);
+
+				if (lengthExtensionSize == 0)
+				{
+					return RESULT_ERROR_CORRUPTED_DATA;
+				}
+
+				inputIterator += lengthExtensionSize;
+				match.length += static_cast<int>(lengthExtension);
+			}
+
+			// A zero offset means that the offset of the previous match is repeated
+			if (DataFormat::HAS_REPEAT_OFFSETS)
+			{
+				if (match.offset == 0)
+				{
+					match.offset = lastOffset;
+				}
+
+				lastOffset = match.offset;
+			}
 
 			// Copy the matched string
 			// In order to achieve high performance, we copy characters in groups of machine words
@@ -202,16 +492,31 @@ Result Decompressor::decompress(const void* source, size_t sourceSize, void* des
 
 			// Fast copying
 			// There must be no overlap between the source and destination words
-
-			do
+			// If the distance is large enough, we copy 8 bytes at once, which speeds up long matches
+			if (outputIterator - matchString >= 2 * WORD_SIZE)
 			{
-				assert(matchString + i >= outputBuffer);
-				assert(matchString + i + WORD_SIZE <= outputEnd);
-				assert(outputIterator + i + WORD_SIZE <= outputEnd);
-				fastWrite(outputIterator + i, fastRead(matchString + i, WORD_SIZE), WORD_SIZE);
-				i += WORD_SIZE;
+				do
+				{
+					assert(matchString + i >= outputBuffer);
+					assert(matchString + i + 2 * WORD_SIZE <= outputEnd);
+					assert(outputIterator + i + 2 * WORD_SIZE <= outputEnd);
+					fastWriteWord(outputIterator + i, fastReadWord<uint64_t>(matchString + i));
+					i += 2 * WORD_SIZE;
+				}
+				while (i < match.length);
+			}
+			else
+			{
+				do
+				{
+					assert(matchString + i >= outputBuffer);
+					assert(matchString + i + WORD_SIZE <= outputEnd);
+					assert(outputIterator + i + WORD_SIZE <= outputEnd);
+					fastWrite(outputIterator + i, fastRead(matchString + i, WORD_SIZE), WORD_SIZE);
+					i += WORD_SIZE;
+				}
+				while (i < match.length);
 			}
-			while (i < match.length);
 			
 			outputIterator += match.length;
 
@@ -219,6 +524,44 @@ Result Decompressor::decompress(const void* source, size_t sourceSize, void* des
 			controlWord >>= 1;
 		}
 	}
+
+	// We have reached the tail, we cannot output literals in runs anymore
+	// Output all remaining literals
+	while (outputIterator < outputEnd)
+	{
+		// Check whether there is enough data left in the input buffer
+		// In order to decode the next literal, we have to read a control word and 1 byte
+		if (inputIterator + DataFormat::CONTROL_WORD_SIZE + 1 > inputEnd)
+		{
+			return RESULT_ERROR_CORRUPTED_DATA;
+		}
+
+		// Check whether we must read a control word
+		if (controlWord == 1)
+		{
+			assert(inputIterator + DataFormat::CONTROL_WORD_SIZE <= inputEnd);
+			controlWord = fastReadWord<ControlWord>(inputIterator);
+			inputIterator += DataFormat::CONTROL_WORD_SIZE;
+		}
+
+		// The tail must contain only literals
+		if ((controlWord & 1) != 0)
+		{
+			return RESULT_ERROR_CORRUPTED_DATA;
+		}
+
+		// Output one literal
+		// We cannot use fast read/write functions
+		assert(inputIterator + 1 <= inputEnd);
+		assert(outputIterator + 1 <= outputEnd);
+		*outputIterator++ = *inputIterator++;
+
+		// Next control word bit
+		controlWord >>= 1;
+	}
+
+	// Done
+	return RESULT_OK;
 }
 
 // Decodes a match and returns its size in bytes
@@ -275,8 +618,11 @@ Result Decompressor::decodeHeader(Header& header, const void* source, size_t sou
 	header.version = attributes & 7;
 	int sizeCodedSize = ((attributes >> 3) & 7) + 1;
 
+	// Since version 5, the attribute byte is followed by the window size byte
+	bool hasWindowSize = header.version >= 5;
+
 	// Compute the size of the header
-	headerSize = 1 + 2 * sizeCodedSize;
+	headerSize = (hasWindowSize ? 2 : 1) + 2 * sizeCodedSize;
 
 	if (sourceSize < static_cast<size_t>(headerSize))
 	{
@@ -285,6 +631,21 @@ Result Decompressor::decodeHeader(Header& header, const void* source, size_t sou
 
 	header.isStored = (attributes & 128) != 0;
 
+	// Decode the window size
+	if (hasWindowSize)
+	{
+		header.windowSizeLog = *inputIterator++;
+
+		if (header.windowSizeLog < MIN_WINDOW_SIZE_LOG || header.windowSizeLog > MAX_WINDOW_SIZE_LOG)
+		{
+			return RESULT_ERROR_CORRUPTED_DATA;
+		}
+	}
+	else
+	{
+		header.windowSizeLog = DEFAULT_WINDOW_SIZE_LOG;
+	}
+
 	// Decode the uncompressed and compressed sizes
 	switch (sizeCodedSize)
 	{
@@ -333,6 +694,7 @@ Result Decompressor::getCompressionInfo(const void* source, size_t sourceSize, C
 	compressionInfo.uncompressedSize = header.uncompressedSize;
 	compressionInfo.compressedSize = header.compressedSize;
 	compressionInfo.version = header.version;
+	compressionInfo.windowSizeLog = header.windowSizeLog;
 
 	return RESULT_OK;
 }
@@ -22,28 +22,72 @@
 
 namespace doboz {
 
+namespace detail {
+
+class DecompressionThreadPool;
+
+} // namespace detail
+
 struct CompressionInfo
 {
 	uint64_t uncompressedSize;
 	uint64_t compressedSize;
 	int version;
+	int windowSizeLog; // the window size is 2^windowSizeLog bytes
 };
 
 class Decompressor
 {
 public:
+	Decompressor();
+	~Decompressor();
+
+	// Copies do not share the threads of the batches
+	Decompressor(const Decompressor& other);
+	Decompressor& operator =(const Decompressor& other);
+
 	// Decompresses a block of data
 	// The source and destination buffers must not overlap
 	// This operation is memory safe
 	// On success, returns RESULT_OK
 	Result decompress(const void* source, size_t sourceSize, void* destination, size_t destinationSize);
 
+	// Decompresses a batch of independent blocks using multiple threads (by default, one per processor)
+	// The threads take the next block from the batch when they are done, so small and large blocks are balanced between them
+	// The threads are created by the first batch which needs them, and they wait for the next batches, so they are not created for every call
+	// A decompressor must not decompress multiple batches at the same time, but it can decompress single blocks concurrently
+	// Returns RESULT_OK if every block has been decompressed successfully, and outputs the result of every block
+	Result decompressBatch(const void* const* sources, const size_t* sourceSizes, void* const* destinations, const size_t* destinationSizes, Result* results, size_t count, int threadCount = 0);
+
 	// Retrieves information about a compressed block of data
 	// This operation is memory safe
 	// On success, returns RESULT_OK and outputs the compression information
 	Result getCompressionInfo(const void* source, size_t sourceSize, CompressionInfo& compressionInfo);
 
+	static const int MAX_THREAD_COUNT = 64;
+
 private:
+	// The shared state of the threads decompressing a batch
+	struct BatchJob
+	{
+		Decompressor* decompressor;
+		const void* const* sources;
+		const size_t* sourceSizes;
+		void* const* destinations;
+		const size_t* destinationSizes;
+		Result* results;
+		size_t count;
+		size_t nextIndex; // the index of the next block to decompress, accessed only with the atomic functions
+	};
+
+	// The threads decompressing the batches, created when first needed
+	detail::DecompressionThreadPool* threadPool_;
+
+	static void decompressBatchBlocks(void* job);
+
+	template <class DataFormat>
+	Result decodeData(const uint8_t* inputIterator, const uint8_t* inputEnd, uint8_t* outputBuffer, uint8_t* outputEnd, int windowSizeLog);
+
 	int decodeMatch(detail::Match& match, const void* source);
 	Result decodeHeader(detail::Header& header, const void* source, size_t sourceSize, int& headerSize);
 };
@@ -22,31 +22,97 @@
 namespace doboz {
 namespace detail {
 
-Dictionary::Dictionary()
-	: hashTable_(0), children_(0)
+Dictionary::Dictionary(int windowSizeLog, int hashTableSizeLog)
+	: buffer_(0), bufferBase_(0), bufferLength_(0), hashTable_(0), children_(0), smallChildren_(0)
 {
+	assert(windowSizeLog >= MIN_MATCH_FINDER_WINDOW_SIZE_LOG && windowSizeLog <= MAX_WINDOW_SIZE_LOG);
+	assert(hashTableSizeLog >= 1 && hashTableSizeLog <= MAX_HASH_TABLE_SIZE_LOG);
+
+	windowSizeLog_ = windowSizeLog;
+	windowSize_ = 1 << windowSizeLog;
+
+	// A hash table larger than the window would only slow down clearing it
+	hashTableSize_ = 1 << std::min(windowSizeLog, hashTableSizeLog);
+
+	childCount_ = windowSize_ * 2;
+	rebaseThreshold_ = (INT_MAX - windowSize_ + 1) / windowSize_ * windowSize_;
+
 	assert(INVALID_POSITION < 0);
-	assert(REBASE_THRESHOLD > DICTIONARY_SIZE && REBASE_THRESHOLD % DICTIONARY_SIZE == 0);
+	assert(rebaseThreshold_ > windowSize_ && rebaseThreshold_ % windowSize_ == 0);
 }
 
 Dictionary::~Dictionary()
 {
 	delete[] hashTable_;
 	delete[] children_;
+	delete[] smallChildren_;
 }
 
 void Dictionary::initialize()
 {
 	// Create the hash table
-	hashTable_ = new int[HASH_TABLE_SIZE];
+	hashTable_ = new int[hashTableSize_];
 
 	// Create the tree nodes
-	// The number of nodes is equal to the size of the dictionary, and every node has two children
-	children_ = new int[CHILD_COUNT];
+	// The number of nodes is equal to the size of the window, and every node has two children
+	if (windowSizeLog_ <= MAX_SMALL_WINDOW_SIZE_LOG)
+	{
+		smallChildren_ = new uint16_t[childCount_];
+	}
+	else
+	{
+		children_ = new int[childCount_];
+	}
+}
+
+void Dictionary::reserve()
+{
+	if (hashTable_ != 0)
+	{
+		return;
+	}
+
+	initialize();
+
+	// Write every page, so that the operating system maps them now instead of during the compression
+	// The hash table is cleared anyway when the first buffer is set, and the nodes are always written before they are read
+	std::fill(hashTable_, hashTable_ + hashTableSize_, static_cast<int>(INVALID_POSITION));
+	if (smallChildren_ != 0)
+	{
+		std::fill(smallChildren_, smallChildren_ + childCount_, static_cast<uint16_t>(0));
+	}
+	else
+	{
+		std::fill(children_, children_ + childCount_, 0);
+	}
+}
+
+size_t Dictionary::getMemorySize(int windowSizeLog, int hashTableSizeLog)
+{
+	size_t hashTableSize = static_cast<size_t>(1) << std::min(windowSizeLog, hashTableSizeLog);
+	size_t childCount = static_cast<size_t>(2) << windowSizeLog;
+	size_t childSize = (windowSizeLog <= MAX_SMALL_WINDOW_SIZE_LOG) ? sizeof(uint16_t) : sizeof(int);
+
+	return hashTableSize * sizeof(int) + childCount * childSize;
 }
 
 void Dictionary::setBuffer(const uint8_t* buffer, size_t bufferLength)
 {
+	// If possible, the relative positions of the new buffer continue after the end of the previous buffer
+	// The strings of the previous buffers are before the start position, so they are never found as matches, and we do not have to clear the dictionary
+	// This makes compressing many small buffers much faster
+	size_t startPosition = 0;
+
+	if (hashTable_ != 0)
+	{
+		size_t previousEnd = (buffer_ + bufferLength_) - bufferBase_;
+
+		if (previousEnd < static_cast<size_t>(rebaseThreshold_) && bufferLength < static_cast<size_t>(rebaseThreshold_) - previousEnd)
+		{
+			startPosition = previousEnd;
+		}
+	}
+
 	// Set the buffer
 	buffer_ = buffer;
 	bufferLength_ = bufferLength;
@@ -66,7 +132,8 @@ void Dictionary::setBuffer(const uint8_t* buffer, size_t bufferLength)
 	// This can be possible, because the difference between any two positions stored in the dictionary never exceeds the size of the dictionary
 	// We don't store larger (64-bit) positions, because that can significantly degrade performance
 	// Initialize the relative position base pointer
-	bufferBase_ = buffer_;
+	bufferBase_ = buffer_ - startPosition;
+	startPosition_ = static_cast<int>(startPosition);
 	
 	// Initialize if necessary
 	if (hashTable_ == 0)
@@ -74,10 +141,13 @@ void Dictionary::setBuffer(const uint8_t* buffer, size_t bufferLength)
 		initialize();
 	}
 
-	// Clear the hash table
-	for (int i = 0; i < HASH_TABLE_SIZE; ++i)
+	// Clear the hash table if the positions start from the beginning
+	if (startPosition == 0)
 	{
-		hashTable_[i] = INVALID_POSITION;
+		for (int i = 0; i < hashTableSize_; ++i)
+		{
+			hashTable_[i] = INVALID_POSITION;
+		}
 	}
 }
 
@@ -89,6 +159,19 @@ int Dictionary::findMatches(Match* matchCandidates)
 {
 	assert(hashTable_ != 0 && "No buffer is set.");
 
+	if (smallChildren_ != 0)
+	{
+		return findMatches(smallChildren_, matchCandidates);
+	}
+
+	return findMatches(children_, matchCandidates);
+}
+
+// The children are stored as differences between the positions of the nodes and their children, so the type of the children can be smaller than int
+// The differences are always less than the window size, because children outside the window are not stored
+template <class Child>
+int Dictionary::findMatches(Child* children, Match* matchCandidates)
+{
 	// Check whether we can find matches at this position
 	if (absolutePosition_ >= matchableBufferLength_)
 	{
@@ -107,10 +190,11 @@ int Dictionary::findMatches(Match* matchCandidates)
 	int position = computeRelativePosition();
 
 	// Compute the minimum match position
-	int minMatchPosition = (position < DICTIONARY_SIZE) ? 0 : (position - DICTIONARY_SIZE + 1);
+	// The strings before the start position are from previous buffers
+	int minMatchPosition = std::max(position - windowSize_ + 1, startPosition_);
 
 	// Compute the hash value for the current string
-	int hashValue = hash(bufferBase_ + position) % HASH_TABLE_SIZE;
+	int hashValue = hash(bufferBase_ + position) & (hashTableSize_ - 1);
 
 	// Get the position of the first match from the hash table
 	int matchPosition = hashTable_[hashValue];
@@ -119,11 +203,13 @@ int Dictionary::findMatches(Match* matchCandidates)
 	hashTable_[hashValue] = position;
 
 	// Compute the current cyclic position in the dictionary
-	int cyclicInputPosition = position % DICTIONARY_SIZE;
+	int cyclicInputPosition = position & (windowSize_ - 1);
 
-	// Initialize the references to the leaves of the new root's left and right subtrees
+	// Initialize the references to the leaves of the new root's left and right subtrees, and the positions of their nodes
 	int leftSubtreeLeaf = cyclicInputPosition * 2;
 	int rightSubtreeLeaf = cyclicInputPosition * 2 + 1;
+	int leftSubtreeLeafPosition = position;
+	int rightSubtreeLeafPosition = position;
 
 	// Initialize the match lenghts of the lower and upper bounds of the current string (lowMatch < match < highMatch)
 	// We use these to avoid unneccesary character comparisons at the beginnings of the strings
@@ -149,15 +235,15 @@ int Dictionary::findMatches(Match* matchCandidates)
 		if (matchPosition < minMatchPosition || matchCount == MAX_MATCH_CANDIDATE_COUNT)
 		{
 			// We have checked all valid matches, so finish the new tree and exit
-			children_[leftSubtreeLeaf] = INVALID_POSITION;
-			children_[rightSubtreeLeaf] = INVALID_POSITION;
+			children[leftSubtreeLeaf] = 0;
+			children[rightSubtreeLeaf] = 0;
 			break;
 		}
 
 		++matchCount;
 
 		// Compute the cyclic position of the current match in the dictionary
-		int cyclicMatchPosition = matchPosition % DICTIONARY_SIZE;
+		int cyclicMatchPosition = matchPosition & (windowSize_ - 1);
 
 		// Use the match lengths of the low and high bounds to determine the number of characters that surely match
 		int matchLength = std::min(lowMatchLength, highMatchLength);
@@ -187,8 +273,14 @@ int Dictionary::findMatches(Match* matchCandidates)
 			if (matchLength == maxMatchLength)
 			{
 				// Since the current string is also the root of the tree, delete the current node
-				children_[leftSubtreeLeaf] = children_[cyclicMatchPosition * 2];
-				children_[rightSubtreeLeaf] = children_[cyclicMatchPosition * 2 + 1];
+				// Its children are moved to the leaves, unless they are outside the window
+				int leftChild = children[cyclicMatchPosition * 2];
+				int rightChild = children[cyclicMatchPosition * 2 + 1];
+				int leftChildPosition = matchPosition - leftChild;
+				int rightChildPosition = matchPosition - rightChild;
+
+				children[leftSubtreeLeaf] = static_cast<Child>((leftChild != 0 && leftChildPosition >= minMatchPosition) ? leftSubtreeLeafPosition - leftChildPosition : 0);
+				children[rightSubtreeLeaf] = static_cast<Child>((rightChild != 0 && rightChildPosition >= minMatchPosition) ? rightSubtreeLeafPosition - rightChildPosition : 0);
 				break;
 			}
 		}
@@ -197,11 +289,12 @@ int Dictionary::findMatches(Match* matchCandidates)
 		if (bufferBase_[position + matchLength] < bufferBase_[matchPosition + matchLength])
 		{
 			// Insert the matched string into the right subtree
-			children_[rightSubtreeLeaf] = matchPosition;
+			children[rightSubtreeLeaf] = static_cast<Child>(rightSubtreeLeafPosition - matchPosition);
 
 			// Go left
 			rightSubtreeLeaf = cyclicMatchPosition * 2;
-			matchPosition = children_[rightSubtreeLeaf];
+			rightSubtreeLeafPosition = matchPosition;
+			matchPosition = (children[rightSubtreeLeaf] != 0) ? matchPosition - children[rightSubtreeLeaf] : INVALID_POSITION;
 
 			// Update the match length of the high bound
 			highMatchLength = matchLength;
@@ -209,11 +302,12 @@ int Dictionary::findMatches(Match* matchCandidates)
 		else
 		{
 			// Insert the matched string into the left subtree
-			children_[leftSubtreeLeaf] = matchPosition;
+			children[leftSubtreeLeaf] = static_cast<Child>(leftSubtreeLeafPosition - matchPosition);
 
 			// Go right
 			leftSubtreeLeaf = cyclicMatchPosition * 2 + 1;
-			matchPosition = children_[leftSubtreeLeaf];
+			leftSubtreeLeafPosition = matchPosition;
+			matchPosition = (children[leftSubtreeLeaf] != 0) ? matchPosition - children[leftSubtreeLeaf] : INVALID_POSITION;
 
 			// Update the match length of the low bound
 			lowMatchLength = matchLength;
@@ -229,32 +323,31 @@ int Dictionary::findMatches(Match* matchCandidates)
 // Increments the match window position with one character
 int Dictionary::computeRelativePosition()
 {
-	int position = static_cast<int>(absolutePosition_ - (bufferBase_ - buffer_));
+	size_t relativePosition = absolutePosition_ - (bufferBase_ - buffer_);
 
 	// Check whether the current position has reached the rebase threshold
-	if (position == REBASE_THRESHOLD)
+	// The position may be beyond the threshold if the dictionary has jumped over it
+	if (relativePosition >= static_cast<size_t>(rebaseThreshold_))
 	{
 		// Rebase
-		int rebaseDelta = REBASE_THRESHOLD - DICTIONARY_SIZE;
-		assert(rebaseDelta % DICTIONARY_SIZE == 0);
+		// Keep the positions of the last window
+		size_t rebaseDelta = (relativePosition / windowSize_ - 1) * windowSize_;
+		assert(rebaseDelta % windowSize_ == 0);
 
 		bufferBase_ += rebaseDelta;
-		position -= rebaseDelta;
+		relativePosition -= rebaseDelta;
+		startPosition_ = (static_cast<size_t>(startPosition_) > rebaseDelta) ? static_cast<int>(startPosition_ - rebaseDelta) : 0;
 
 		// Rebase the hash entries
-		for (int i = 0; i < HASH_TABLE_SIZE; ++i)
+		for (int i = 0; i < hashTableSize_; ++i)
 		{
-			hashTable_[i] = (hashTable_[i] >= rebaseDelta) ? (hashTable_[i] - rebaseDelta) : INVALID_POSITION;
+			hashTable_[i] = (hashTable_[i] >= 0 && static_cast<size_t>(hashTable_[i]) >= rebaseDelta) ? static_cast<int>(hashTable_[i] - rebaseDelta) : INVALID_POSITION;
 		}
 
-		// Rebase the binary tree nodes
-		for (int i = 0; i < CHILD_COUNT; ++i)
-		{
-			children_[i] = (children_[i] >= rebaseDelta) ? (children_[i] - rebaseDelta) : INVALID_POSITION;
-		}
+		// The binary tree nodes store relative positions, so they do not have to be rebased
 	}
 	
-	return position;
+	return static_cast<int>(relativePosition);
 }
 
 // Slides the matching window to the next character without looking for matches, but it still has to update the dictionary
@@ -263,17 +356,11 @@ void Dictionary::skip()
 	findMatches(0);
 }
 
-uint32_t Dictionary::hash(const uint8_t* data)
+// Slides the matching window with the specified number of characters without updating the dictionary
+// The skipped strings cannot be found as matches later, but this is much faster than skipping them one by one
+void Dictionary::jump(size_t count)
 {
-	// FNV-1a hash
-	const uint32_t prime = 16777619;
-	uint32_t result = 2166136261;
-
-	result = (result ^ data[0]) * prime;
-	result = (result ^ data[1]) * prime;
-	result = (result ^ data[2]) * prime;
-
-	return result;
+	absolutePosition_ += count;
 }
 
 } // namespace detail
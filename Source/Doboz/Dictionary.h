@@ -26,40 +26,75 @@ namespace detail {
 class Dictionary
 {
 public:
-	Dictionary();
+	explicit Dictionary(int windowSizeLog = DEFAULT_WINDOW_SIZE_LOG, int hashTableSizeLog = MAX_HASH_TABLE_SIZE_LOG);
 	~Dictionary();
 
 	void setBuffer(const uint8_t* buffer, size_t bufferLength);
 
+	// Allocates the dictionary and touches all of its memory, if it is not allocated yet
+	void reserve();
+
+	// Returns the size of the memory allocated by a dictionary with the specified window and hash table sizes
+	static size_t getMemorySize(int windowSizeLog, int hashTableSizeLog = MAX_HASH_TABLE_SIZE_LOG);
+
 	int findMatches(Match* matchCandidates);
 	void skip();
+	void jump(size_t count);
 
 	size_t position() const
 	{
 		return absolutePosition_;
 	}
 
+	int windowSizeLog() const
+	{
+		return windowSizeLog_;
+	}
+
+	// Returns the hash value of the first MIN_MATCH_LENGTH bytes of a string
+	static uint32_t hash(const uint8_t* data)
+	{
+		// FNV-1a hash
+		const uint32_t prime = 16777619;
+		uint32_t result = 2166136261;
+
+		result = (result ^ data[0]) * prime;
+		result = (result ^ data[1]) * prime;
+		result = (result ^ data[2]) * prime;
+
+		return result;
+	}
+
 private:
-	static const int HASH_TABLE_SIZE = 1 << 20;
-	static const int CHILD_COUNT = DICTIONARY_SIZE * 2;
 	static const int INVALID_POSITION = -1;
-	static const int REBASE_THRESHOLD = (INT_MAX - DICTIONARY_SIZE + 1) / DICTIONARY_SIZE * DICTIONARY_SIZE; // must be a multiple of DICTIONARY_SIZE!
+	static const int MAX_SMALL_WINDOW_SIZE_LOG = 16; // the largest window whose children fit into 16 bits
+
+	// Window
+	int windowSizeLog_;
+	int windowSize_; // the size of the cyclic dictionary, a power of 2
+	int hashTableSize_; // a power of 2
+	int childCount_;
+	int rebaseThreshold_; // must be a multiple of windowSize_!
 
 	// Buffer
 	const uint8_t* buffer_; // pointer to the beginning of the buffer inside which we look for matches
-	const uint8_t* bufferBase_; // bufferBase_ > buffer_, relative positions are necessary to support > 2 GB buffers
+	const uint8_t* bufferBase_; // relative positions are necessary to support > 2 GB buffers, bufferBase_ < buffer_ if the positions continue after a previous buffer
+	int startPosition_; // the relative position of the beginning of the buffer, the dictionary may contain strings of previous buffers before it
 	size_t bufferLength_;
 	size_t matchableBufferLength_;
 	size_t absolutePosition_; // position from the beginning of buffer_
 
 	// Cyclic dictionary
 	int* hashTable_; // relative match positions to bufferBase_
-	int* children_; // children of the binary tree nodes (relative match positions to bufferBase_)
+	int* children_; // children of the binary tree nodes (the position of the node minus the position of the child, or 0 if there is no child)
+	uint16_t* smallChildren_; // used instead of children_ with small windows, which halves the memory usage
 
 	void initialize();
 
+	template <class Child>
+	int findMatches(Child* children, Match* matchCandidates);
+
 	int computeRelativePosition();
-	uint32_t hash(const uint8_t* data);
 };
 
 } // namespace detail
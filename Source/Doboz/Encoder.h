@@ -0,0 +1,312 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <algorithm>
+#include "Common.h"
+
+namespace doboz {
+namespace detail {
+
+// Encodes literals and matches using the latest version of the format
+// The literal/match bits are collected in control words, which precede the literals and matches they refer to
+class Encoder
+{
+public:
+	typedef Format<VERSION> DataFormat;
+	typedef DataFormat::ControlWord ControlWord;
+
+	static const int CONTROL_WORD_SIZE = DataFormat::CONTROL_WORD_SIZE;
+	static const int TRAILING_DUMMY_SIZE = DataFormat::TRAILING_DUMMY_SIZE;
+	static const int MAX_MATCH_CODED_SIZE = DataFormat::MAX_MATCH_CODED_SIZE;
+
+	// Begins the compressed data at the specified position
+	// The offsets of the matches must be less than the window size
+	void begin(void* destination, void* destinationEnd, int windowSizeLog)
+	{
+		outputIterator_ = static_cast<uint8_t*>(destination);
+		outputEnd_ = static_cast<uint8_t*>(destinationEnd);
+
+		// The offsets which do not fit into the 4-byte match code are extended with the necessary number of bytes
+		windowSize_ = 1 << windowSizeLog;
+		offsetExtensionSize_ = std::max(windowSizeLog - LONG_MATCH_CODE_OFFSET_BIT_COUNT + 7, 0) / 8;
+		assert(offsetExtensionSize_ <= DataFormat::MAX_OFFSET_EXTENSION_SIZE);
+
+		// Initialize the control word which contains the literal/match bits
+		// The highest bit of a control word is a guard bit, which marks the end of the bit list
+		// The guard bit simplifies and speeds up the decoding process
+		controlWord_ = CONTROL_WORD_GUARD_BIT;
+		controlWordBit_ = 0;
+
+		// Since we do not know the contents of the control words in advance, we allocate space for them and subsequently fill them with data as soon as we can
+		// This is necessary because the decoder must encounter a control word *before* the literals and matches it refers to
+		// We begin the compressed data with a control word
+		controlWordPointer_ = outputIterator_;
+		outputIterator_ += CONTROL_WORD_SIZE;
+
+		lastOffset_ = INITIAL_REPEAT_OFFSET;
+	}
+
+	// Begins a segment, which continues the compressed data of the previous segment
+	// The offset of the last match of the previous segment is unknown, so there is no repeat offset until the first match
+	void beginSegment(void* destination, void* destinationEnd, int windowSizeLog)
+	{
+		begin(destination, destinationEnd, windowSizeLog);
+		lastOffset_ = 0;
+	}
+
+	// Finishes the compressed data and returns its end
+	uint8_t* end()
+	{
+		// Flush the control word
+		fastWriteWord(controlWordPointer_, controlWord_);
+
+		// Output trailing safety dummy bytes
+		// This reduces the number of necessary buffer checks during decoding
+		memset(outputIterator_, 0, TRAILING_DUMMY_SIZE);
+		outputIterator_ += TRAILING_DUMMY_SIZE;
+
+		return outputIterator_;
+	}
+
+	// Finishes a segment, which is followed by the next segment, and returns its end
+	// The guard bit of the last control word is moved after its last used bit, so the decoder continues with the first control word of the next segment
+	uint8_t* endSegment()
+	{
+		assert(controlWordBit_ > 0);
+
+		fastWriteWord(controlWordPointer_, (controlWord_ & ~CONTROL_WORD_GUARD_BIT) | (static_cast<ControlWord>(1) << controlWordBit_));
+		return outputIterator_;
+	}
+
+	// Returns the current end of the compressed data
+	uint8_t* position() const
+	{
+		return outputIterator_;
+	}
+
+	// Returns whether a run of literals and optionally a match can be encoded, so that the finished data surely fits into the destination
+	bool hasSpaceFor(size_t literalCount, bool hasMatch) const
+	{
+		size_t maxCodedSize = getMaxEncodedLiteralsSize(literalCount) + (hasMatch ? CONTROL_WORD_SIZE + MAX_MATCH_CODED_SIZE : 0) + TRAILING_DUMMY_SIZE;
+		return maxCodedSize <= static_cast<size_t>(outputEnd_ - outputIterator_);
+	}
+
+	DOBOZ_FORCEINLINE void encodeLiteral(uint8_t literal)
+	{
+		// Encode a literal (0 control word flag)
+		// In order to efficiently decode literals in runs, the literal bit (0) must differ from the guard bit (1)
+		encodeControlBit(0);
+		*outputIterator_++ = literal;
+	}
+
+	// Encodes a run of consecutive literals
+	// Long runs are encoded with literal run tokens, which can be decoded with a single copy
+	void encodeLiterals(const uint8_t* literals, size_t count)
+	{
+		if (count < MIN_LITERAL_RUN_LENGTH)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				encodeLiteral(literals[i]);
+			}
+
+			return;
+		}
+
+		while (count > 0)
+		{
+			uint32_t runLength = static_cast<uint32_t>(std::min(count, static_cast<size_t>(MAX_VAR_INT_VALUE)));
+
+			// A literal run is marked with a match flag and a special match code
+			encodeControlBit(1);
+			*outputIterator_++ = LITERAL_RUN_CODE;
+			outputIterator_ += encodeVarInt(runLength, outputIterator_);
+
+			memcpy(outputIterator_, literals, runLength);
+			outputIterator_ += runLength;
+
+			literals += runLength;
+			count -= runLength;
+		}
+	}
+
+	DOBOZ_FORCEINLINE void encodeMatch(const Match& match)
+	{
+		// Encode a match (1 control word flag)
+		encodeControlBit(1);
+		outputIterator_ += encodeMatchCode(match, outputIterator_);
+
+		lastOffset_ = match.offset;
+	}
+
+	// Returns the number of bytes the match would be encoded in at the current position
+	int getMatchCodedSize(const Match& match) const
+	{
+		return encodeMatchCode(match, 0);
+	}
+
+	// Returns the number of bytes the match would be encoded in after a match with the specified offset
+	static int getMatchCodedSize(const Match& match, int repeatOffset, int windowSizeLog)
+	{
+		Encoder encoder;
+		encoder.windowSize_ = 1 << windowSizeLog;
+		encoder.offsetExtensionSize_ = std::max(windowSizeLog - LONG_MATCH_CODE_OFFSET_BIT_COUNT + 7, 0) / 8;
+		encoder.lastOffset_ = repeatOffset;
+
+		return encoder.encodeMatchCode(match, 0);
+	}
+
+	// Returns the offset of the previous match, which can be encoded more efficiently
+	int getRepeatOffset() const
+	{
+		return lastOffset_;
+	}
+
+	// Returns the maximum number of bytes (including the control words) used to encode a run of literals
+	static size_t getMaxLiteralsCodedSize(size_t count)
+	{
+		return count + (count / CONTROL_WORD_BIT_COUNT + 1) * CONTROL_WORD_SIZE + (count / MAX_VAR_INT_VALUE + 1) * (1 + MAX_VAR_INT_SIZE);
+	}
+
+private:
+	static const int CONTROL_WORD_BIT_COUNT = CONTROL_WORD_SIZE * 8 - 1;
+	static const ControlWord CONTROL_WORD_GUARD_BIT = static_cast<ControlWord>(1) << CONTROL_WORD_BIT_COUNT;
+
+	uint8_t* outputIterator_;
+	uint8_t* outputEnd_;
+	uint8_t* controlWordPointer_;
+	ControlWord controlWord_;
+	int controlWordBit_;
+
+	int windowSize_;
+	int offsetExtensionSize_; // the number of high offset bytes following the 4-byte match codes
+
+	int lastOffset_; // the offset of the previous match
+
+	// Returns the maximum number of bytes (including the control words) written by encodeLiterals
+	// Long runs need a single control bit, so this is less than getMaxLiteralsCodedSize, which also covers literals encoded one by one
+	static size_t getMaxEncodedLiteralsSize(size_t count)
+	{
+		if (count < MIN_LITERAL_RUN_LENGTH)
+		{
+			return count + (count / CONTROL_WORD_BIT_COUNT + 1) * CONTROL_WORD_SIZE;
+		}
+
+		size_t runCount = count / MAX_VAR_INT_VALUE + 1;
+		return count + runCount * (1 + MAX_VAR_INT_SIZE) + (runCount / CONTROL_WORD_BIT_COUNT + 1) * CONTROL_WORD_SIZE;
+	}
+
+	// Appends a literal (0) or match (1) bit to the control word
+	DOBOZ_FORCEINLINE void encodeControlBit(int bit)
+	{
+		// Check whether the control word must be flushed
+		if (controlWordBit_ == CONTROL_WORD_BIT_COUNT)
+		{
+			// Flush current control word
+			fastWriteWord(controlWordPointer_, controlWord_);
+
+			// New control word
+			controlWord_ = CONTROL_WORD_GUARD_BIT;
+			controlWordBit_ = 0;
+
+			controlWordPointer_ = outputIterator_;
+			outputIterator_ += CONTROL_WORD_SIZE;
+		}
+
+		controlWord_ |= static_cast<ControlWord>(bit) << controlWordBit_;
+		++controlWordBit_;
+	}
+
+	int encodeMatchCode(const Match& match, void* destination) const
+	{
+		assert(match.length <= MAX_EXTENDED_MATCH_LENGTH);
+		assert(match.length == 0 || match.offset < windowSize_);
+
+		uint32_t word;
+		int size;
+
+		// Matches with the maximum length or longer have a length extension after the 4-byte code
+		uint32_t lengthCode = static_cast<uint32_t>(std::min(match.length, MAX_MATCH_LENGTH) - MIN_MATCH_LENGTH);
+		uint32_t offsetCode = static_cast<uint32_t>(match.offset);
+
+		// Repeated offsets are encoded as zero, except when the original offset fits into a 1-byte code
+		// A 1-byte code with a zero offset would be a literal run
+		if (match.offset == lastOffset_ && !(lengthCode == 0 && offsetCode < 64))
+		{
+			offsetCode = 0;
+		}
+
+		if (lengthCode == 0 && offsetCode < 64 && offsetCode != 0)
+		{
+			word = offsetCode << 2; // 00
+			size = 1;
+		}
+		else if (lengthCode == 0 && offsetCode < 16384)
+		{
+			word = (offsetCode << 2) | 1; // 01
+			size = 2;
+		}
+		else if (lengthCode < 16 && offsetCode < 1024)
+		{
+			word = (offsetCode << 6) | (lengthCode << 2) | 2; // 10
+			size = 2;
+		}
+		else if (lengthCode < 32 && offsetCode < 65536)
+		{
+			word = (offsetCode << 8) | (lengthCode << 3) | 3; // 11
+			size = 3;
+		}
+		else
+		{
+			word = (offsetCode << 11) | (lengthCode << 3) | 7; // 111
+			size = 4;
+		}
+
+		if (destination != 0)
+		{
+			fastWrite(destination, word, size);
+		}
+
+		if (size == 4)
+		{
+			for (int i = 0; i < offsetExtensionSize_; ++i)
+			{
+				if (destination != 0)
+				{
+					static_cast<uint8_t*>(destination)[size] = static_cast<uint8_t>(offsetCode >> (LONG_MATCH_CODE_OFFSET_BIT_COUNT + 8 * i));
+				}
+
+				++size;
+			}
+		}
+
+		if (match.length >= MAX_MATCH_LENGTH)
+		{
+			uint32_t lengthExtension = static_cast<uint32_t>(match.length - MAX_MATCH_LENGTH);
+			size += encodeVarInt(lengthExtension, (destination != 0) ? static_cast<uint8_t*>(destination) + size : 0);
+		}
+
+		return size;
+	}
+};
+
+} // namespace detail
+} // namespace doboz
\ No newline at end of file
@@ -0,0 +1,264 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <algorithm>
+#include "HashChainMatchFinder.h"
+#include "Dictionary.h"
+
+namespace doboz {
+namespace detail {
+
+HashChainMatchFinder::HashChainMatchFinder(int windowSizeLog, int hashTableSizeLog, int maxChainLength)
+	: buffer_(0), bufferBase_(0), bufferLength_(0), hashTable_(0), chains_(0), smallChains_(0)
+{
+	assert(windowSizeLog >= MIN_MATCH_FINDER_WINDOW_SIZE_LOG && windowSizeLog <= MAX_WINDOW_SIZE_LOG);
+	assert(hashTableSizeLog >= 1 && hashTableSizeLog <= MAX_HASH_TABLE_SIZE_LOG);
+	assert(maxChainLength >= 1 && maxChainLength <= MAX_MATCH_CANDIDATE_COUNT);
+
+	windowSizeLog_ = windowSizeLog;
+	windowSize_ = 1 << windowSizeLog;
+	hashTableSize_ = 1 << std::min(windowSizeLog, hashTableSizeLog);
+	rebaseThreshold_ = (INT_MAX - windowSize_ + 1) / windowSize_ * windowSize_;
+	maxChainLength_ = maxChainLength;
+
+	assert(INVALID_POSITION < 0);
+	assert(rebaseThreshold_ > windowSize_ && rebaseThreshold_ % windowSize_ == 0);
+}
+
+HashChainMatchFinder::~HashChainMatchFinder()
+{
+	delete[] hashTable_;
+	delete[] chains_;
+	delete[] smallChains_;
+}
+
+void HashChainMatchFinder::initialize()
+{
+	hashTable_ = new int[hashTableSize_];
+
+	if (windowSizeLog_ <= MAX_SMALL_WINDOW_SIZE_LOG)
+	{
+		smallChains_ = new uint16_t[windowSize_];
+	}
+	else
+	{
+		chains_ = new int[windowSize_];
+	}
+}
+
+void HashChainMatchFinder::reserve()
+{
+	if (hashTable_ != 0)
+	{
+		return;
+	}
+
+	initialize();
+
+	// Write every page, so that the operating system maps them now instead of during the compression
+	std::fill(hashTable_, hashTable_ + hashTableSize_, static_cast<int>(INVALID_POSITION));
+
+	if (smallChains_ != 0)
+	{
+		std::fill(smallChains_, smallChains_ + windowSize_, static_cast<uint16_t>(0));
+	}
+	else
+	{
+		std::fill(chains_, chains_ + windowSize_, 0);
+	}
+}
+
+size_t HashChainMatchFinder::getMemorySize(int windowSizeLog, int hashTableSizeLog)
+{
+	size_t hashTableSize = static_cast<size_t>(1) << std::min(windowSizeLog, hashTableSizeLog);
+	size_t chainCount = static_cast<size_t>(1) << windowSizeLog;
+	size_t linkSize = (windowSizeLog <= MAX_SMALL_WINDOW_SIZE_LOG) ? sizeof(uint16_t) : sizeof(int);
+
+	return hashTableSize * sizeof(int) + chainCount * linkSize;
+}
+
+void HashChainMatchFinder::setBuffer(const uint8_t* buffer, size_t bufferLength)
+{
+	// The relative positions of the new buffer continue after the end of the previous buffer if possible (see Dictionary)
+	size_t startPosition = 0;
+
+	if (hashTable_ != 0)
+	{
+		size_t previousEnd = (buffer_ + bufferLength_) - bufferBase_;
+
+		if (previousEnd < static_cast<size_t>(rebaseThreshold_) && bufferLength < static_cast<size_t>(rebaseThreshold_) - previousEnd)
+		{
+			startPosition = previousEnd;
+		}
+	}
+
+	// Set the buffer
+	buffer_ = buffer;
+	bufferLength_ = bufferLength;
+	absolutePosition_ = 0;
+
+	// Compute the matchable buffer length
+	if (bufferLength_ > TAIL_LENGTH + MIN_MATCH_LENGTH)
+	{
+		matchableBufferLength_ = bufferLength_ - (TAIL_LENGTH + MIN_MATCH_LENGTH);
+	}
+	else
+	{
+		matchableBufferLength_ = 0;
+	}
+
+	bufferBase_ = buffer_ - startPosition;
+	startPosition_ = static_cast<int>(startPosition);
+
+	// Initialize if necessary
+	if (hashTable_ == 0)
+	{
+		initialize();
+	}
+
+	// Clear the hash table if the positions start from the beginning
+	// The chains do not have to be cleared, because they are followed only from valid positions
+	if (startPosition == 0)
+	{
+		for (int i = 0; i < hashTableSize_; ++i)
+		{
+			hashTable_[i] = INVALID_POSITION;
+		}
+	}
+}
+
+// Finds match candidates at the current buffer position and slides the matching window to the next character
+// The match candidates are stored in the supplied array, ordered by their length (ascending)
+// If the array is null, the current string is only inserted into the hash chains
+int HashChainMatchFinder::findMatches(Match* matchCandidates)
+{
+	assert(hashTable_ != 0 && "No buffer is set.");
+
+	if (smallChains_ != 0)
+	{
+		return findMatches(smallChains_, matchCandidates);
+	}
+
+	return findMatches(chains_, matchCandidates);
+}
+
+// The chains store distances, which are less than the window size, so the type of the links can be smaller than int
+template <class Link>
+int HashChainMatchFinder::findMatches(Link* chains, Match* matchCandidates)
+{
+	// Check whether we can find matches at this position
+	if (absolutePosition_ >= matchableBufferLength_)
+	{
+		++absolutePosition_;
+		return 0;
+	}
+
+	int maxMatchLength = static_cast<int>(std::min(bufferLength_ - TAIL_LENGTH - absolutePosition_, static_cast<size_t>(MAX_MATCH_LENGTH)));
+	int position = computeRelativePosition();
+	int minMatchPosition = std::max(position - windowSize_ + 1, startPosition_);
+
+	// Insert the current string at the beginning of its hash chain
+	int hashValue = Dictionary::hash(bufferBase_ + position) & (hashTableSize_ - 1);
+	int matchPosition = hashTable_[hashValue];
+
+	hashTable_[hashValue] = position;
+	chains[position & (windowSize_ - 1)] = static_cast<Link>((matchPosition >= minMatchPosition) ? position - matchPosition : 0);
+
+	++absolutePosition_;
+
+	if (matchCandidates == 0)
+	{
+		return 0;
+	}
+
+	// Check the most recent strings with the same hash value
+	// The chain entry of a position inside the window has not been overwritten yet
+	int longestMatchLength = MIN_MATCH_LENGTH - 1;
+	int matchCandidateCount = 0;
+
+	for (int i = 0; i < maxChainLength_ && matchPosition >= minMatchPosition; ++i)
+	{
+		// Only longer matches are candidates, so first check the character after the longest match
+		if (bufferBase_[matchPosition + longestMatchLength] == bufferBase_[position + longestMatchLength])
+		{
+			int matchLength = 0;
+
+			while (matchLength < maxMatchLength && bufferBase_[position + matchLength] == bufferBase_[matchPosition + matchLength])
+			{
+				++matchLength;
+			}
+
+			if (matchLength > longestMatchLength)
+			{
+				longestMatchLength = matchLength;
+
+				matchCandidates[matchCandidateCount].length = matchLength;
+				matchCandidates[matchCandidateCount].offset = position - matchPosition;
+				++matchCandidateCount;
+
+				if (matchLength == maxMatchLength)
+				{
+					break;
+				}
+			}
+		}
+
+		Link distance = chains[matchPosition & (windowSize_ - 1)];
+		matchPosition = (distance != 0) ? matchPosition - distance : INVALID_POSITION;
+	}
+
+	return matchCandidateCount;
+}
+
+int HashChainMatchFinder::computeRelativePosition()
+{
+	size_t relativePosition = absolutePosition_ - (bufferBase_ - buffer_);
+
+	// Rebase the positions if the current position has reached the rebase threshold (see Dictionary)
+	if (relativePosition >= static_cast<size_t>(rebaseThreshold_))
+	{
+		size_t rebaseDelta = (relativePosition / windowSize_ - 1) * windowSize_;
+		assert(rebaseDelta % windowSize_ == 0);
+
+		bufferBase_ += rebaseDelta;
+		relativePosition -= rebaseDelta;
+		startPosition_ = (static_cast<size_t>(startPosition_) > rebaseDelta) ? static_cast<int>(startPosition_ - rebaseDelta) : 0;
+
+		for (int i = 0; i < hashTableSize_; ++i)
+		{
+			hashTable_[i] = (hashTable_[i] >= 0 && static_cast<size_t>(hashTable_[i]) >= rebaseDelta) ? static_cast<int>(hashTable_[i] - rebaseDelta) : INVALID_POSITION;
+		}
+
+		// The chains store distances, so they do not have to be rebased
+	}
+
+	return static_cast<int>(relativePosition);
+}
+
+void HashChainMatchFinder::skip()
+{
+	findMatches(0);
+}
+
+void HashChainMatchFinder::jump(size_t count)
+{
+	absolutePosition_ += count;
+}
+
+} // namespace detail
+} // namespace doboz
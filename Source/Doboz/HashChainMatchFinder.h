@@ -0,0 +1,104 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#include "Common.h"
+
+namespace doboz {
+namespace detail {
+
+// Match finder based on hash chains, which has the same interface as Dictionary
+// Every position is linked to the previous position with the same hash, and only the most recent ones are checked
+// It needs half as much memory as Dictionary with the same window, but it finds shorter matches
+class HashChainMatchFinder
+{
+public:
+	static const int DEFAULT_MAX_CHAIN_LENGTH = 32;
+
+	// At most maxChainLength of the most recent positions are checked for matches
+	explicit HashChainMatchFinder(int windowSizeLog = DEFAULT_WINDOW_SIZE_LOG, int hashTableSizeLog = MAX_HASH_TABLE_SIZE_LOG, int maxChainLength = DEFAULT_MAX_CHAIN_LENGTH);
+	~HashChainMatchFinder();
+
+	void setBuffer(const uint8_t* buffer, size_t bufferLength);
+
+	// Allocates the hash chains and touches all of their memory, if they are not allocated yet
+	void reserve();
+
+	// Returns the size of the memory allocated by a match finder with the specified window and hash table sizes
+	static size_t getMemorySize(int windowSizeLog, int hashTableSizeLog = MAX_HASH_TABLE_SIZE_LOG);
+
+	int findMatches(Match* matchCandidates);
+	void skip();
+	void jump(size_t count);
+
+	size_t position() const
+	{
+		return absolutePosition_;
+	}
+
+	int windowSizeLog() const
+	{
+		return windowSizeLog_;
+	}
+
+	// The search depth may be changed between blocks, without recreating the match finder
+	void setMaxChainLength(int maxChainLength)
+	{
+		assert(maxChainLength >= 1 && maxChainLength <= MAX_MATCH_CANDIDATE_COUNT);
+		maxChainLength_ = maxChainLength;
+	}
+
+private:
+	static const int INVALID_POSITION = -1;
+	static const int MAX_SMALL_WINDOW_SIZE_LOG = 16; // the largest window whose chain links fit into 16 bits
+
+	// Window
+	int windowSizeLog_;
+	int windowSize_; // the size of the cyclic chain buffer, a power of 2
+	int hashTableSize_; // a power of 2
+	int rebaseThreshold_; // must be a multiple of windowSize_!
+	int maxChainLength_; // the maximum number of checked positions
+
+	// Buffer (see Dictionary)
+	const uint8_t* buffer_;
+	const uint8_t* bufferBase_;
+	int startPosition_;
+	size_t bufferLength_;
+	size_t matchableBufferLength_;
+	size_t absolutePosition_;
+
+	// Hash chains
+	int* hashTable_; // the relative position of the last string with each hash value
+	int* chains_; // the distance of the previous string with the same hash value for each cyclic position, or 0 if it is outside the window
+	uint16_t* smallChains_; // used instead of chains_ with small windows, which halves the memory usage
+
+	void initialize();
+
+	template <class Link>
+	int findMatches(Link* chains, Match* matchCandidates);
+
+	int computeRelativePosition();
+
+	// Non-copyable
+	HashChainMatchFinder(const HashChainMatchFinder&);
+	HashChainMatchFinder& operator =(const HashChainMatchFinder&);
+};
+
+} // namespace detail
+} // namespace doboz
@@ -0,0 +1,211 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <algorithm>
+#include "LongDistanceMatcher.h"
+
+namespace doboz {
+namespace detail {
+
+LongDistanceMatcher::LongDistanceMatcher(int windowSizeLog)
+	: hashTable_(0)
+{
+	assert(windowSizeLog >= MIN_WINDOW_SIZE_LOG && windowSizeLog <= MAX_WINDOW_SIZE_LOG);
+
+	windowSize_ = 1 << windowSizeLog;
+
+	// We expect one indexed position per 2^STRIDE_LOG bytes of the window
+	hashTableSizeLog_ = std::max(windowSizeLog - STRIDE_LOG, static_cast<int>(MIN_HASH_TABLE_SIZE_LOG));
+
+	removedFactor_ = 1;
+
+	for (int i = 0; i < HASH_LENGTH - 1; ++i)
+	{
+		removedFactor_ *= HASH_PRIME;
+	}
+}
+
+LongDistanceMatcher::~LongDistanceMatcher()
+{
+	delete[] hashTable_;
+}
+
+void LongDistanceMatcher::initialize()
+{
+	// Create the hash table
+	hashTable_ = new size_t[static_cast<size_t>(1) << hashTableSizeLog_];
+}
+
+void LongDistanceMatcher::reserve()
+{
+	if (hashTable_ != 0)
+	{
+		return;
+	}
+
+	initialize();
+
+	// Write every page, so that the operating system maps them now instead of during the compression
+	std::fill(hashTable_, hashTable_ + (static_cast<size_t>(1) << hashTableSizeLog_), static_cast<size_t>(INVALID_POSITION));
+}
+
+size_t LongDistanceMatcher::getMemorySize(int windowSizeLog)
+{
+	int hashTableSizeLog = std::max(windowSizeLog - STRIDE_LOG, static_cast<int>(MIN_HASH_TABLE_SIZE_LOG));
+	return sizeof(size_t) << hashTableSizeLog;
+}
+
+void LongDistanceMatcher::setBuffer(const uint8_t* buffer, size_t bufferLength, size_t startPosition)
+{
+	// Set the buffer
+	buffer_ = buffer;
+	bufferLength_ = bufferLength;
+
+	// Compute the number of hashable positions
+	// Matches must not end in the tail of the buffer (see Dictionary)
+	if (bufferLength_ >= TAIL_LENGTH + HASH_LENGTH)
+	{
+		matchableBufferLength_ = bufferLength_ - (TAIL_LENGTH + HASH_LENGTH) + 1;
+	}
+	else
+	{
+		matchableBufferLength_ = 0;
+	}
+
+	// Initialize if necessary
+	if (hashTable_ == 0)
+	{
+		initialize();
+	}
+
+	// Clear the hash table
+	size_t hashTableSize = static_cast<size_t>(1) << hashTableSizeLog_;
+
+	for (size_t i = 0; i < hashTableSize; ++i)
+	{
+		hashTable_[i] = INVALID_POSITION;
+	}
+
+	// Hash the first string
+	scanPosition_ = startPosition;
+	hash_ = 0;
+
+	if (scanPosition_ < matchableBufferLength_)
+	{
+		for (int i = 0; i < HASH_LENGTH; ++i)
+		{
+			hash_ = hash_ * HASH_PRIME + buffer_[scanPosition_ + i];
+		}
+	}
+
+	match_.position = startPosition;
+	match_.length = 0;
+	match_.offset = 0;
+}
+
+const LongDistanceMatcher::LongMatch& LongDistanceMatcher::findMatch(size_t position)
+{
+	assert(hashTable_ != 0 && "No buffer is set.");
+
+	// Look for the next match if the last one ends before the position
+	while (match_.position + match_.length <= position)
+	{
+		if (!scan())
+		{
+			match_.length = 0;
+			break;
+		}
+	}
+
+	return match_;
+}
+
+// Scans the buffer until the next long match is found
+// Returns false if the end of the buffer has been reached
+bool LongDistanceMatcher::scan()
+{
+	// The positions inside the last match are indexed, but we do not look for matches there
+	size_t lastMatchEnd = match_.position + match_.length;
+
+	while (scanPosition_ < matchableBufferLength_)
+	{
+		size_t position = scanPosition_;
+		uint64_t hashValue = hash_;
+
+		// Roll the hash to the next position
+		if (position + 1 < matchableBufferLength_)
+		{
+			hash_ = (hash_ - buffer_[position] * removedFactor_) * HASH_PRIME + buffer_[position + HASH_LENGTH];
+		}
+
+		++scanPosition_;
+
+		// Index only the positions with the highest STRIDE_LOG bits of the hash value cleared
+		// The high bits of the hash value depend on all the bytes of the string
+		if ((hashValue >> (64 - STRIDE_LOG)) != 0)
+		{
+			continue;
+		}
+
+		size_t hashTableIndex = static_cast<size_t>(hashValue >> (64 - STRIDE_LOG - hashTableSizeLog_)) & ((static_cast<size_t>(1) << hashTableSizeLog_) - 1);
+		size_t matchPosition = hashTable_[hashTableIndex];
+		hashTable_[hashTableIndex] = position;
+
+		// Check whether the indexed position is a valid match candidate
+		if (matchPosition == INVALID_POSITION || position < lastMatchEnd || position - matchPosition >= static_cast<size_t>(windowSize_))
+		{
+			continue;
+		}
+
+		int offset = static_cast<int>(position - matchPosition);
+
+		// Extend the match backwards, but not into the last match
+		size_t matchStart = position;
+
+		while (matchStart > lastMatchEnd && matchStart > static_cast<size_t>(offset) && position - matchStart < static_cast<size_t>(MAX_EXTENDED_MATCH_LENGTH) &&
+			buffer_[matchStart - 1] == buffer_[matchStart - 1 - offset])
+		{
+			--matchStart;
+		}
+
+		// Extend the match forwards
+		size_t maxMatchEnd = std::min(bufferLength_ - TAIL_LENGTH, matchStart + MAX_EXTENDED_MATCH_LENGTH);
+		size_t matchEnd = position;
+
+		while (matchEnd < maxMatchEnd && buffer_[matchEnd] == buffer_[matchEnd - offset])
+		{
+			++matchEnd;
+		}
+
+		// The match must be at least as long as the hashed string, otherwise it's a hash collision
+		if (matchEnd - position < static_cast<size_t>(HASH_LENGTH))
+		{
+			continue;
+		}
+
+		match_.position = matchStart;
+		match_.length = static_cast<int>(matchEnd - matchStart);
+		match_.offset = offset;
+		return true;
+	}
+
+	return false;
+}
+
+} // namespace detail
+} // namespace doboz
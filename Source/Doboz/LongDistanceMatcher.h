@@ -0,0 +1,86 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#include "Common.h"
+
+namespace doboz {
+namespace detail {
+
+// Finds long repeats anywhere in the window, which can be much larger than the window of the dictionary
+// Only a subset of the positions are indexed, selected by a rolling hash of the following bytes
+// Since the selection depends only on the content, the repeats of indexed strings are selected too
+class LongDistanceMatcher
+{
+public:
+	struct LongMatch
+	{
+		size_t position;
+		int length;
+		int offset;
+	};
+
+	explicit LongDistanceMatcher(int windowSizeLog);
+	~LongDistanceMatcher();
+
+	// The strings before the start position are not indexed
+	void setBuffer(const uint8_t* buffer, size_t bufferLength, size_t startPosition = 0);
+
+	// Allocates the hash table and touches all of its memory, if it is not allocated yet
+	void reserve();
+
+	// Returns the size of the memory allocated by a matcher with the specified window size
+	static size_t getMemorySize(int windowSizeLog);
+
+	// Returns the first long match which ends after the specified position
+	// The returned match has a length of 0 if there are no more long matches
+	// Call findMatch with increasing positions
+	const LongMatch& findMatch(size_t position);
+
+private:
+	static const int HASH_LENGTH = 64; // the length of the hashed strings, and the minimum length of long matches
+	static const int STRIDE_LOG = 6; // the average distance of the indexed positions is 2^STRIDE_LOG
+	static const int MIN_HASH_TABLE_SIZE_LOG = 10;
+	static const size_t INVALID_POSITION = static_cast<size_t>(-1);
+
+	static const uint64_t HASH_PRIME = 0x100000001B3ULL;
+
+	int windowSize_;
+	int hashTableSizeLog_;
+
+	// Buffer
+	const uint8_t* buffer_;
+	size_t bufferLength_;
+	size_t matchableBufferLength_;
+
+	// Scanning
+	size_t scanPosition_; // the position of the next string to hash
+	uint64_t hash_; // the rolling hash of the string at scanPosition_
+	uint64_t removedFactor_; // HASH_PRIME^(HASH_LENGTH - 1), the factor of the byte removed from the rolling hash
+	LongMatch match_; // the last match found
+
+	size_t* hashTable_; // the last indexed position for each hash value
+
+	void initialize();
+
+	bool scan();
+};
+
+} // namespace detail
+} // namespace doboz
@@ -0,0 +1,348 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <algorithm>
+#include "Common.h"
+#include "Thread.h"
+
+namespace doboz {
+namespace detail {
+
+// Runs a match finder on a separate thread ahead of the compressor, which parses and encodes the matches in parallel
+// The match candidates are passed in batches through a lock-free ring buffer with a single producer and a single consumer
+// The thread is started with the first buffer and reused for the following ones, and it is blocked while it has nothing to do
+// The match finder does not know which positions will be skipped by the compressor, so it finds the matches at almost every position
+// Only inside long repeats, which will be skipped by the compressor anyway, are most of the positions jumped over
+template <class MatchFinder>
+class PipelinedMatchFinder
+{
+public:
+	explicit PipelinedMatchFinder(MatchFinder& matchFinder)
+		: matchFinder_(matchFinder),
+		  batches_(0),
+		  isThreadRunning_(false),
+		  isPipelined_(false)
+	{
+	}
+
+	~PipelinedMatchFinder()
+	{
+		stop();
+
+		if (isThreadRunning_)
+		{
+			isExiting_ = true;
+			startEvent_.set();
+			thread_.join();
+		}
+
+		delete[] batches_;
+	}
+
+	// Starts finding the matches in the buffer on the match finder thread
+	void setBuffer(const uint8_t* buffer, size_t bufferLength)
+	{
+		stop();
+
+		if (batches_ == 0)
+		{
+			batches_ = new Batch[BATCH_COUNT];
+		}
+
+		matchFinder_.setBuffer(buffer, bufferLength);
+
+		buffer_ = buffer;
+		bufferLength_ = bufferLength;
+		position_ = 0;
+		writtenBatchCount_ = 0;
+		readBatchCount_ = 0;
+		isStopped_ = false;
+
+		// If the thread cannot be created, the matches are found on the current thread
+		if (!isThreadRunning_)
+		{
+			isExiting_ = false;
+			isThreadRunning_ = thread_.tryStart(run, this);
+		}
+
+		isPipelined_ = isThreadRunning_;
+		if (isPipelined_)
+		{
+			startEvent_.set();
+		}
+	}
+
+	// Allocates the batches and touches all of their memory, if they are not allocated yet
+	// The memory of the match finder is not reserved
+	void reserve()
+	{
+		if (batches_ == 0)
+		{
+			batches_ = new Batch[BATCH_COUNT];
+			memset(batches_, 0, BATCH_COUNT * sizeof(Batch));
+		}
+	}
+
+	// Returns the size of the memory allocated by the batches
+	static size_t getMemorySize()
+	{
+		return BATCH_COUNT * sizeof(Batch);
+	}
+
+	// Stops finding the matches in the buffer, and waits until the match finder thread is idle
+	// The buffer must not be freed before calling this
+	void stop()
+	{
+		if (isPipelined_)
+		{
+			atomicStore(isStopped_, true);
+			batchReadEvent_.set();
+			stoppedEvent_.wait();
+			isPipelined_ = false;
+		}
+	}
+
+	int findMatches(Match* matchCandidates)
+	{
+		if (!isPipelined_)
+		{
+			return matchFinder_.findMatches(matchCandidates);
+		}
+
+		if (position_ >= bufferLength_)
+		{
+			++position_;
+			return 0;
+		}
+
+		const Batch& batch = getBatch();
+		int positionIndex = static_cast<int>(position_ - batch.position);
+		int candidateBegin = (positionIndex == 0) ? 0 : batch.candidateEnds[positionIndex - 1];
+		int candidateEnd = batch.candidateEnds[positionIndex];
+
+		std::copy(batch.candidates + candidateBegin, batch.candidates + candidateEnd, matchCandidates);
+		++position_;
+
+		return candidateEnd - candidateBegin;
+	}
+
+	void skip()
+	{
+		if (!isPipelined_)
+		{
+			matchFinder_.skip();
+			return;
+		}
+
+		++position_;
+	}
+
+	void jump(size_t count)
+	{
+		if (!isPipelined_)
+		{
+			matchFinder_.jump(count);
+			return;
+		}
+
+		position_ += count;
+	}
+
+	size_t position() const
+	{
+		return isPipelined_ ? position_ : matchFinder_.position();
+	}
+
+	int windowSizeLog() const
+	{
+		return matchFinder_.windowSizeLog();
+	}
+
+private:
+	static const int LONG_MATCH_SKIP_STRIDE = 16; // the same as in the default parser of the compressor
+	static const int BATCH_COUNT = 8;
+	static const int MAX_BATCH_POSITION_COUNT = 4096;
+	static const int MAX_BATCH_CANDIDATE_COUNT = 4 * MAX_BATCH_POSITION_COUNT; // batches with many candidates have fewer positions
+
+	// The match candidates of consecutive positions
+	struct Batch
+	{
+		size_t position; // the first position
+		int positionCount;
+		int candidateEnds[MAX_BATCH_POSITION_COUNT]; // the end of the candidate list of each position
+		Match candidates[MAX_BATCH_CANDIDATE_COUNT];
+	};
+
+	MatchFinder& matchFinder_;
+	Thread thread_;
+	Batch* batches_; // ring buffer
+	bool isThreadRunning_;
+	bool isExiting_;
+	bool isPipelined_;
+
+	Event startEvent_; // set when there is a new buffer or the thread should exit
+	Event stoppedEvent_; // set when the thread has finished with the buffer
+	Event batchWrittenEvent_; // set after publishing a batch
+	Event batchReadEvent_; // set after releasing a batch, or when the thread should stop
+
+	const uint8_t* buffer_;
+	size_t bufferLength_;
+	size_t position_; // the position of the compressor
+
+	volatile size_t writtenBatchCount_; // written by the match finder thread
+	volatile size_t readBatchCount_; // written by the compressor thread
+	volatile bool isStopped_;
+
+	static void run(void* pipelinedMatchFinder)
+	{
+		static_cast<PipelinedMatchFinder*>(pipelinedMatchFinder)->work();
+	}
+
+	// Finds the matches in every new buffer until the thread should exit
+	// The events also make the members written before setting them visible to the other thread
+	void work()
+	{
+		for (;;)
+		{
+			startEvent_.wait();
+			if (isExiting_)
+			{
+				return;
+			}
+
+			produce();
+			stoppedEvent_.set();
+		}
+	}
+
+	// Finds the matches at every position, and writes them into the ring buffer
+	void produce()
+	{
+		size_t position = 0;
+		size_t batchCount = 0;
+
+		// Inside long repeats, only every LONG_MATCH_SKIP_STRIDE-th position is added to the match finder, except for the last ones
+		size_t longMatchPosition = 0;
+		size_t sparseEnd = 0;
+
+		while (position < bufferLength_)
+		{
+			// Wait for a free batch
+			while (batchCount - atomicLoad(readBatchCount_) == BATCH_COUNT)
+			{
+				if (atomicLoad(isStopped_))
+				{
+					return;
+				}
+
+				batchReadEvent_.wait();
+			}
+
+			Batch& batch = batches_[batchCount % BATCH_COUNT];
+			int positionCount = 0;
+			int candidateCount = 0;
+
+			batch.position = position;
+
+			while (position < bufferLength_ && positionCount < MAX_BATCH_POSITION_COUNT && candidateCount + MAX_MATCH_CANDIDATE_COUNT <= MAX_BATCH_CANDIDATE_COUNT)
+			{
+				if (position < sparseEnd && (position - longMatchPosition) % LONG_MATCH_SKIP_STRIDE != 0)
+				{
+					matchFinder_.jump(1);
+				}
+				else
+				{
+					int matchCandidateCount = matchFinder_.findMatches(batch.candidates + candidateCount);
+
+					// If the longest match has the maximum length, the compressor will most likely skip the repeat
+					if (position >= sparseEnd && matchCandidateCount > 0 && batch.candidates[candidateCount + matchCandidateCount - 1].length == MAX_MATCH_LENGTH)
+					{
+						longMatchPosition = position;
+						sparseEnd = getLongMatchEnd(position, batch.candidates[candidateCount + matchCandidateCount - 1].offset) - MAX_MATCH_LENGTH;
+					}
+
+					candidateCount += matchCandidateCount;
+				}
+
+				batch.candidateEnds[positionCount++] = candidateCount;
+				++position;
+			}
+
+			batch.positionCount = positionCount;
+
+			// Publish the batch
+			atomicStore(writtenBatchCount_, ++batchCount);
+			batchWrittenEvent_.set();
+
+			if (atomicLoad(isStopped_))
+			{
+				return;
+			}
+		}
+	}
+
+	// Returns the end of a long match, extended as far as possible
+	size_t getLongMatchEnd(size_t position, int offset)
+	{
+		// Matches must not end in the tail of the buffer (see Dictionary)
+		size_t matchEnd = position + MAX_MATCH_LENGTH;
+		size_t maxMatchEnd = std::min(bufferLength_ - TAIL_LENGTH, position + MAX_EXTENDED_MATCH_LENGTH);
+
+		while (matchEnd < maxMatchEnd && buffer_[matchEnd] == buffer_[matchEnd - offset])
+		{
+			++matchEnd;
+		}
+
+		return matchEnd;
+	}
+
+	// Returns the batch containing the current position, and releases the batches before it
+	// Waits for the match finder thread if the batch has not been written yet
+	const Batch& getBatch()
+	{
+		for (;;)
+		{
+			size_t readBatchCount = readBatchCount_;
+
+			while (readBatchCount == atomicLoad(writtenBatchCount_))
+			{
+				batchWrittenEvent_.wait();
+			}
+
+			const Batch& batch = batches_[readBatchCount % BATCH_COUNT];
+
+			if (position_ < batch.position + batch.positionCount)
+			{
+				return batch;
+			}
+
+			atomicStore(readBatchCount_, readBatchCount + 1);
+			batchReadEvent_.set();
+		}
+	}
+
+	// Non-copyable
+	PipelinedMatchFinder(const PipelinedMatchFinder&);
+	PipelinedMatchFinder& operator =(const PipelinedMatchFinder&);
+};
+
+} // namespace detail
+} // namespace doboz
@@ -0,0 +1,95 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#include "Common.h"
+#include "Encoder.h"
+
+namespace doboz {
+namespace detail {
+
+// Collects the literals and matches in sequences instead of encoding them
+// The matches are selected with the same costs as by the Encoder
+class SequenceEncoder
+{
+public:
+	// Begins the sequences at the specified position
+	void begin(Sequence* sequences, Sequence* sequencesEnd, int windowSizeLog)
+	{
+		sequenceIterator_ = sequences;
+		sequencesEnd_ = sequencesEnd;
+		windowSizeLog_ = windowSizeLog;
+
+		literalLength_ = 0;
+		lastOffset_ = INITIAL_REPEAT_OFFSET;
+	}
+
+	// Finishes the sequences with the remaining literals and returns their end
+	Sequence* end()
+	{
+		sequenceIterator_->literalLength = literalLength_;
+		sequenceIterator_->matchLength = 0;
+		sequenceIterator_->offset = 0;
+
+		return ++sequenceIterator_;
+	}
+
+	// Returns whether a run of literals and optionally a match can be added, so that the last sequence still fits
+	bool hasSpaceFor(size_t /*literalCount*/, bool hasMatch) const
+	{
+		return (hasMatch ? 2 : 1) <= sequencesEnd_ - sequenceIterator_;
+	}
+
+	void encodeLiterals(const uint8_t* /*literals*/, size_t count)
+	{
+		literalLength_ += count;
+	}
+
+	void encodeMatch(const Match& match)
+	{
+		sequenceIterator_->literalLength = literalLength_;
+		sequenceIterator_->matchLength = match.length;
+		sequenceIterator_->offset = match.offset;
+		++sequenceIterator_;
+
+		literalLength_ = 0;
+		lastOffset_ = match.offset;
+	}
+
+	int getMatchCodedSize(const Match& match) const
+	{
+		return Encoder::getMatchCodedSize(match, lastOffset_, windowSizeLog_);
+	}
+
+	int getRepeatOffset() const
+	{
+		return lastOffset_;
+	}
+
+private:
+	Sequence* sequenceIterator_;
+	Sequence* sequencesEnd_;
+	int windowSizeLog_;
+
+	size_t literalLength_; // the number of literals since the last match
+	int lastOffset_; // the offset of the previous match
+};
+
+} // namespace detail
+} // namespace doboz
@@ -0,0 +1,292 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <cstring>
+#include "SuffixArray.h"
+
+namespace doboz {
+namespace detail {
+
+// SA-IS: G. Nong, S. Zhang, W. H. Chan, "Two Efficient Algorithms for Linear Time Suffix Array Construction"
+// The texts must end with a unique sentinel character, which is smaller than every other character
+
+namespace {
+
+// Byte text with a virtual sentinel at the end
+class ByteText
+{
+public:
+	ByteText(const uint8_t* data, int length)
+		: data_(data), length_(length)
+	{
+	}
+
+	int operator [](int i) const
+	{
+		return (i < length_) ? (data_[i] + 1) : 0;
+	}
+
+private:
+	const uint8_t* data_;
+	int length_;
+};
+
+// Reduced text of the recursion, which already ends with a sentinel
+class IntText
+{
+public:
+	explicit IntText(const int* data)
+		: data_(data)
+	{
+	}
+
+	int operator [](int i) const
+	{
+		return data_[i];
+	}
+
+private:
+	const int* data_;
+};
+
+// Suffix types: L (false) if the suffix is greater than the next one, otherwise S (true)
+inline bool isLms(const bool* types, int i)
+{
+	return i > 0 && types[i] && !types[i - 1];
+}
+
+// Computes the beginnings or the ends of the character buckets
+template <class Text>
+void getBuckets(const Text& text, int length, int maxCharacter, int* buckets, bool end)
+{
+	memset(buckets, 0, (maxCharacter + 1) * sizeof(int));
+
+	for (int i = 0; i < length; ++i)
+	{
+		++buckets[text[i]];
+	}
+
+	int sum = 0;
+
+	for (int i = 0; i <= maxCharacter; ++i)
+	{
+		sum += buckets[i];
+		buckets[i] = end ? sum : (sum - buckets[i]);
+	}
+}
+
+// Induces the order of the L-type suffixes from the sorted LMS suffixes
+template <class Text>
+void induceL(const Text& text, const bool* types, int length, int maxCharacter, int* buckets, int* suffixArray)
+{
+	getBuckets(text, length, maxCharacter, buckets, false);
+
+	for (int i = 0; i < length; ++i)
+	{
+		int j = suffixArray[i] - 1;
+
+		if (j >= 0 && !types[j])
+		{
+			suffixArray[buckets[text[j]]++] = j;
+		}
+	}
+}
+
+// Induces the order of the S-type suffixes from the sorted L-type suffixes
+template <class Text>
+void induceS(const Text& text, const bool* types, int length, int maxCharacter, int* buckets, int* suffixArray)
+{
+	getBuckets(text, length, maxCharacter, buckets, true);
+
+	for (int i = length - 1; i >= 0; --i)
+	{
+		int j = suffixArray[i] - 1;
+
+		if (j >= 0 && types[j])
+		{
+			suffixArray[--buckets[text[j]]] = j;
+		}
+	}
+}
+
+template <class Text>
+void sais(const Text& text, int length, int maxCharacter, int* suffixArray)
+{
+	assert(length >= 1);
+
+	if (length == 1)
+	{
+		suffixArray[0] = 0;
+		return;
+	}
+
+	// Classify the suffixes
+	bool* types = new bool[length];
+	types[length - 1] = true;
+	types[length - 2] = false;
+
+	for (int i = length - 3; i >= 0; --i)
+	{
+		types[i] = text[i] < text[i + 1] || (text[i] == text[i + 1] && types[i + 1]);
+	}
+
+	int* buckets = new int[maxCharacter + 1];
+
+	// Sort the LMS substrings by inducing from the unsorted LMS suffixes
+	getBuckets(text, length, maxCharacter, buckets, true);
+
+	for (int i = 0; i < length; ++i)
+	{
+		suffixArray[i] = -1;
+	}
+
+	for (int i = 1; i < length; ++i)
+	{
+		if (isLms(types, i))
+		{
+			suffixArray[--buckets[text[i]]] = i;
+		}
+	}
+
+	induceL(text, types, length, maxCharacter, buckets, suffixArray);
+	induceS(text, types, length, maxCharacter, buckets, suffixArray);
+
+	// Compact the sorted LMS substrings into the first part of the suffix array
+	int lmsCount = 0;
+
+	for (int i = 0; i < length; ++i)
+	{
+		if (isLms(types, suffixArray[i]))
+		{
+			suffixArray[lmsCount++] = suffixArray[i];
+		}
+	}
+
+	for (int i = lmsCount; i < length; ++i)
+	{
+		suffixArray[i] = -1;
+	}
+
+	// Name the LMS substrings: equal substrings get the same name
+	// The names are stored in the second part of the suffix array, indexed by position / 2 (LMS positions are at least 2 apart)
+	int nameCount = 0;
+	int previousPosition = -1;
+
+	for (int i = 0; i < lmsCount; ++i)
+	{
+		int position = suffixArray[i];
+		bool isDifferent = false;
+
+		for (int d = 0; d < length; ++d)
+		{
+			if (previousPosition == -1 || text[position + d] != text[previousPosition + d] || types[position + d] != types[previousPosition + d])
+			{
+				isDifferent = true;
+				break;
+			}
+
+			if (d > 0 && (isLms(types, position + d) || isLms(types, previousPosition + d)))
+			{
+				break;
+			}
+		}
+
+		if (isDifferent)
+		{
+			++nameCount;
+			previousPosition = position;
+		}
+
+		suffixArray[lmsCount + position / 2] = nameCount - 1;
+	}
+
+	// Gather the names in text order at the end of the suffix array: this is the reduced text
+	for (int i = length - 1, j = length - 1; i >= lmsCount; --i)
+	{
+		if (suffixArray[i] >= 0)
+		{
+			suffixArray[j--] = suffixArray[i];
+		}
+	}
+
+	// Sort the LMS suffixes by sorting the reduced text
+	int* reducedSuffixArray = suffixArray;
+	int* reducedText = suffixArray + length - lmsCount;
+
+	if (nameCount < lmsCount)
+	{
+		sais(IntText(reducedText), lmsCount, nameCount - 1, reducedSuffixArray);
+	}
+	else
+	{
+		// The names are unique, so the suffix array of the reduced text is its inverse
+		for (int i = 0; i < lmsCount; ++i)
+		{
+			reducedSuffixArray[reducedText[i]] = i;
+		}
+	}
+
+	// Map the reduced suffixes back to the LMS positions
+	for (int i = 1, j = 0; i < length; ++i)
+	{
+		if (isLms(types, i))
+		{
+			reducedText[j++] = i;
+		}
+	}
+
+	for (int i = 0; i < lmsCount; ++i)
+	{
+		reducedSuffixArray[i] = reducedText[reducedSuffixArray[i]];
+	}
+
+	for (int i = lmsCount; i < length; ++i)
+	{
+		suffixArray[i] = -1;
+	}
+
+	// Induce the order of all suffixes from the sorted LMS suffixes
+	getBuckets(text, length, maxCharacter, buckets, true);
+
+	for (int i = lmsCount - 1; i >= 0; --i)
+	{
+		int j = suffixArray[i];
+		suffixArray[i] = -1;
+		suffixArray[--buckets[text[j]]] = j;
+	}
+
+	induceL(text, types, length, maxCharacter, buckets, suffixArray);
+	induceS(text, types, length, maxCharacter, buckets, suffixArray);
+
+	delete[] buckets;
+	delete[] types;
+}
+
+} // namespace
+
+void buildSuffixArray(const uint8_t* text, int length, int* suffixArray)
+{
+	assert(length >= 0);
+
+	// The first suffix is always the sentinel, so we remove it
+	sais(ByteText(text, length), length + 1, 256, suffixArray);
+	memmove(suffixArray, suffixArray + 1, length * sizeof(int));
+}
+
+} // namespace detail
+} // namespace doboz
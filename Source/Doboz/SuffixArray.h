@@ -0,0 +1,31 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#include "Common.h"
+
+namespace doboz {
+namespace detail {
+
+// Builds the suffix array of the text in linear time using the SA-IS algorithm
+// The suffix array must have room for length + 1 elements, but only the first length elements are valid on return
+void buildSuffixArray(const uint8_t* text, int length, int* suffixArray);
+
+} // namespace detail
+} // namespace doboz
@@ -0,0 +1,571 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <cstring>
+#include <algorithm>
+#include "SuffixArrayMatchFinder.h"
+#include "SuffixArray.h"
+#include "Thread.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace doboz {
+namespace detail {
+
+namespace {
+
+DOBOZ_FORCEINLINE int getLowestBit(uint32_t word)
+{
+	assert(word != 0);
+
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, word);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(word);
+#endif
+}
+
+DOBOZ_FORCEINLINE int getHighestBit(uint32_t word)
+{
+	assert(word != 0);
+
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse(&index, word);
+	return static_cast<int>(index);
+#else
+	return 31 - __builtin_clz(word);
+#endif
+}
+
+} // namespace
+
+SuffixArrayMatchFinder::SuffixArrayMatchFinder(int windowSizeLog, int threadCount)
+	: ranks_(0), rankCapacity_(0)
+{
+	assert(windowSizeLog >= MIN_WINDOW_SIZE_LOG && windowSizeLog <= MAX_WINDOW_SIZE_LOG);
+	assert(threadCount >= 1);
+
+	windowSizeLog_ = windowSizeLog;
+	windowSize_ = 1 << windowSizeLog;
+
+	// The window is part of the suffix array of every block, so large blocks reduce the overhead
+	blockSize_ = std::max(windowSize_, static_cast<int>(MIN_BLOCK_SIZE));
+	threadCount_ = std::min(threadCount, static_cast<int>(MAX_THREAD_COUNT));
+
+	for (int i = 0; i < MAX_THREAD_COUNT; ++i)
+	{
+		segments_[i].suffixArray = 0;
+		segments_[i].capacity = 0;
+	}
+}
+
+SuffixArrayMatchFinder::~SuffixArrayMatchFinder()
+{
+	for (int i = 0; i < MAX_THREAD_COUNT; ++i)
+	{
+		delete[] segments_[i].suffixArray;
+	}
+
+	delete[] ranks_;
+}
+
+void SuffixArrayMatchFinder::reserve(size_t maxBufferLength)
+{
+	int segmentCount;
+	int maxTextLength;
+	getSegmentSizes(windowSizeLog_, threadCount_, maxBufferLength, segmentCount, maxTextLength);
+
+	// Write every page, so that the operating system maps them now instead of during the compression
+	for (int i = 0; i < segmentCount; ++i)
+	{
+		Segment& segment = segments_[i];
+
+		if (segment.capacity < maxTextLength)
+		{
+			delete[] segment.suffixArray;
+			segment.suffixArray = new int[maxTextLength + 1];
+			segment.capacity = maxTextLength;
+			std::fill(segment.suffixArray, segment.suffixArray + maxTextLength + 1, 0);
+		}
+	}
+
+	if (rankCapacity_ < maxTextLength)
+	{
+		delete[] ranks_;
+		ranks_ = new int[maxTextLength];
+		rankCapacity_ = maxTextLength;
+		std::fill(ranks_, ranks_ + maxTextLength, 0);
+	}
+
+	window_.reset(maxTextLength);
+}
+
+size_t SuffixArrayMatchFinder::getMemorySize(int windowSizeLog, int threadCount, size_t bufferLength)
+{
+	int segmentCount;
+	int maxTextLength;
+	getSegmentSizes(windowSizeLog, threadCount, bufferLength, segmentCount, maxTextLength);
+
+	// Every segment has a suffix array, and while it is built, the types of the suffixes and the buckets of the reduced texts
+	// These temporary arrays need at most 2 bytes per suffix for the types and 2 bytes per suffix for the buckets
+	size_t segmentSize = static_cast<size_t>(maxTextLength + 1) * sizeof(int) + static_cast<size_t>(maxTextLength) * 4;
+
+	// The ranks and the window of the current segment
+	size_t currentSegmentSize = static_cast<size_t>(maxTextLength) * sizeof(int) + RankSet::getMemorySize(maxTextLength);
+
+	return segmentCount * segmentSize + currentSegmentSize;
+}
+
+// Computes the number of segments built in parallel, and the maximum length of their texts
+void SuffixArrayMatchFinder::getSegmentSizes(int windowSizeLog, int threadCount, size_t bufferLength, int& segmentCount, int& maxTextLength)
+{
+	int windowSize = 1 << windowSizeLog;
+	int blockSize = std::max(windowSize, static_cast<int>(MIN_BLOCK_SIZE));
+	int maxSegmentCount = std::min(threadCount, static_cast<int>(MAX_THREAD_COUNT));
+
+	size_t blockCount = (bufferLength + blockSize - 1) / blockSize;
+	segmentCount = static_cast<int>(std::min(blockCount, static_cast<size_t>(maxSegmentCount)));
+
+	// The text of a block contains the window before it and the longest match from its last position
+	size_t textLength = static_cast<size_t>(blockSize) + (windowSize - 1) + MAX_MATCH_LENGTH;
+	maxTextLength = static_cast<int>(std::min(bufferLength, textLength));
+}
+
+void SuffixArrayMatchFinder::setBuffer(const uint8_t* buffer, size_t bufferLength)
+{
+	// Set the buffer
+	buffer_ = buffer;
+	bufferLength_ = bufferLength;
+	position_ = 0;
+
+	// Compute the matchable buffer length
+	if (bufferLength_ > TAIL_LENGTH + MIN_MATCH_LENGTH)
+	{
+		matchableBufferLength_ = bufferLength_ - (TAIL_LENGTH + MIN_MATCH_LENGTH);
+	}
+	else
+	{
+		matchableBufferLength_ = 0;
+	}
+
+	// The segments are built on demand
+	segmentCount_ = 0;
+	segmentIndex_ = -1;
+	nextBlockStart_ = 0;
+}
+
+// Finds match candidates at the current buffer position and slides the matching window to the next character
+// The match candidates are stored in the supplied array, ordered by their length (ascending)
+// The return value is the number of match candidates in the array
+int SuffixArrayMatchFinder::findMatches(Match* matchCandidates)
+{
+	// Check whether we can find matches at this position
+	if (position_ >= matchableBufferLength_)
+	{
+		++position_;
+		return 0;
+	}
+
+	const Segment& segment = getSegment();
+
+	// Compute the maximum match length
+	int maxMatchLength = static_cast<int>(std::min(bufferLength_ - TAIL_LENGTH - position_, static_cast<size_t>(MAX_MATCH_LENGTH)));
+
+	// The suffixes with the longest common prefixes are the nearest ones in the suffix array
+	// We walk the suffixes of the window in both directions from the current suffix, while the common prefixes get shorter
+	int rank = ranks_[position_ - segment.textStart];
+	int matchCandidateCount = 0;
+
+	for (int direction = 0; direction < 2; ++direction)
+	{
+		int matchRank = rank;
+		int matchLength = maxMatchLength;
+
+		for (int i = 0; i < MAX_MATCH_CANDIDATE_COUNT / 2; ++i)
+		{
+			matchRank = (direction == 0) ? window_.findPredecessor(matchRank) : window_.findSuccessor(matchRank);
+
+			if (matchRank < 0)
+			{
+				break;
+			}
+
+			size_t matchPosition = segment.textStart + segment.suffixArray[matchRank];
+			matchLength = getMatchLength(matchPosition, matchLength);
+
+			if (matchLength < MIN_MATCH_LENGTH)
+			{
+				break;
+			}
+
+			matchCandidates[matchCandidateCount].length = matchLength;
+			matchCandidates[matchCandidateCount].offset = static_cast<int>(position_ - matchPosition);
+			++matchCandidateCount;
+		}
+	}
+
+	// Slide the matching window with one character
+	slideWindow(segment);
+	++position_;
+
+	// Sort the match candidates by their offsets
+	for (int i = 1; i < matchCandidateCount; ++i)
+	{
+		Match match = matchCandidates[i];
+		int j = i;
+
+		for (; j > 0 && matchCandidates[j - 1].offset > match.offset; --j)
+		{
+			matchCandidates[j] = matchCandidates[j - 1];
+		}
+
+		matchCandidates[j] = match;
+	}
+
+	// Keep only the candidates which are longer than the ones with lower offsets
+	int goodMatchCandidateCount = 0;
+
+	for (int i = 0; i < matchCandidateCount; ++i)
+	{
+		if (goodMatchCandidateCount == 0 || matchCandidates[i].length > matchCandidates[goodMatchCandidateCount - 1].length)
+		{
+			matchCandidates[goodMatchCandidateCount++] = matchCandidates[i];
+		}
+	}
+
+	return goodMatchCandidateCount;
+}
+
+// Slides the matching window to the next character without looking for matches
+void SuffixArrayMatchFinder::skip()
+{
+	if (position_ < matchableBufferLength_)
+	{
+		slideWindow(getSegment());
+	}
+
+	++position_;
+}
+
+// Slides the matching window with the specified number of characters
+// Unlike Dictionary, the skipped strings are still added to the window, because this is cheap
+void SuffixArrayMatchFinder::jump(size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		skip();
+	}
+}
+
+// Returns the segment of the current position, and loads the next segment if necessary
+const SuffixArrayMatchFinder::Segment& SuffixArrayMatchFinder::getSegment()
+{
+	if (segmentIndex_ < 0 || position_ >= segments_[segmentIndex_].blockEnd)
+	{
+		++segmentIndex_;
+
+		if (segmentIndex_ >= segmentCount_)
+		{
+			buildSegments();
+			segmentIndex_ = 0;
+		}
+
+		loadSegment(segments_[segmentIndex_]);
+	}
+
+	assert(position_ >= segments_[segmentIndex_].blockStart && position_ < segments_[segmentIndex_].blockEnd);
+	return segments_[segmentIndex_];
+}
+
+// Builds the suffix arrays of the next batch of blocks in parallel
+void SuffixArrayMatchFinder::buildSegments()
+{
+	segmentCount_ = 0;
+
+	while (segmentCount_ < threadCount_ && nextBlockStart_ < matchableBufferLength_)
+	{
+		Segment& segment = segments_[segmentCount_];
+
+		segment.buffer = buffer_;
+		segment.blockStart = nextBlockStart_;
+		segment.blockEnd = std::min(nextBlockStart_ + blockSize_, matchableBufferLength_);
+		segment.textStart = (segment.blockStart >= static_cast<size_t>(windowSize_ - 1)) ? (segment.blockStart - (windowSize_ - 1)) : 0;
+		segment.textEnd = std::min(segment.blockEnd + MAX_MATCH_LENGTH, bufferLength_);
+
+		// Allocate the suffix array if necessary
+		int textLength = static_cast<int>(segment.textEnd - segment.textStart);
+
+		if (segment.capacity < textLength)
+		{
+			delete[] segment.suffixArray;
+			segment.suffixArray = new int[textLength + 1];
+			segment.capacity = textLength;
+		}
+
+		nextBlockStart_ = segment.blockEnd;
+		++segmentCount_;
+	}
+
+	assert(segmentCount_ > 0);
+
+	Thread threads[MAX_THREAD_COUNT];
+
+	for (int i = 1; i < segmentCount_; ++i)
+	{
+		threads[i].start(buildSegment, &segments_[i]);
+	}
+
+	buildSegment(&segments_[0]);
+
+	for (int i = 1; i < segmentCount_; ++i)
+	{
+		threads[i].join();
+	}
+}
+
+void SuffixArrayMatchFinder::buildSegment(void* segment)
+{
+	Segment& s = *static_cast<Segment*>(segment);
+	detail::buildSuffixArray(s.buffer + s.textStart, static_cast<int>(s.textEnd - s.textStart), s.suffixArray);
+}
+
+// Computes the ranks of the suffixes of the segment, and initializes the window of the first position of the block
+void SuffixArrayMatchFinder::loadSegment(const Segment& segment)
+{
+	int textLength = static_cast<int>(segment.textEnd - segment.textStart);
+
+	if (rankCapacity_ < textLength)
+	{
+		delete[] ranks_;
+		ranks_ = new int[textLength];
+		rankCapacity_ = textLength;
+	}
+
+	for (int i = 0; i < textLength; ++i)
+	{
+		ranks_[segment.suffixArray[i]] = i;
+	}
+
+	window_.reset(textLength);
+
+	for (size_t i = segment.textStart; i < segment.blockStart; ++i)
+	{
+		window_.insert(ranks_[i - segment.textStart]);
+	}
+}
+
+// Adds the current position to the window, and removes the position which is too far from the next position
+void SuffixArrayMatchFinder::slideWindow(const Segment& segment)
+{
+	window_.insert(ranks_[position_ - segment.textStart]);
+
+	if (position_ + 1 >= static_cast<size_t>(windowSize_))
+	{
+		size_t removedPosition = position_ + 1 - windowSize_;
+
+		if (removedPosition >= segment.textStart)
+		{
+			window_.erase(ranks_[removedPosition - segment.textStart]);
+		}
+	}
+}
+
+int SuffixArrayMatchFinder::getMatchLength(size_t matchPosition, int maxMatchLength) const
+{
+	const uint8_t* string = buffer_ + position_;
+	const uint8_t* matchString = buffer_ + matchPosition;
+	int matchLength = 0;
+
+	while (matchLength < maxMatchLength && string[matchLength] == matchString[matchLength])
+	{
+		++matchLength;
+	}
+
+	return matchLength;
+}
+
+SuffixArrayMatchFinder::RankSet::RankSet()
+	: levelCount_(0), capacity_(0)
+{
+	levels_[0] = 0;
+}
+
+SuffixArrayMatchFinder::RankSet::~RankSet()
+{
+	delete[] levels_[0];
+}
+
+// Clears the set, and prepares it for ranks less than the specified size
+void SuffixArrayMatchFinder::RankSet::reset(int size)
+{
+	// Compute the size of the levels
+	int totalSize = 0;
+	int bitCount = size;
+	levelCount_ = 0;
+
+	do
+	{
+		assert(levelCount_ < MAX_LEVEL_COUNT);
+
+		levelSizes_[levelCount_] = (bitCount + 31) / 32;
+		bitCount = levelSizes_[levelCount_];
+		totalSize += levelSizes_[levelCount_];
+		++levelCount_;
+	}
+	while (bitCount > 1);
+
+	// Allocate the levels in a single array
+	if (capacity_ < totalSize)
+	{
+		delete[] levels_[0];
+		levels_[0] = new uint32_t[totalSize];
+		capacity_ = totalSize;
+	}
+
+	for (int i = 1; i < levelCount_; ++i)
+	{
+		levels_[i] = levels_[i - 1] + levelSizes_[i - 1];
+	}
+
+	memset(levels_[0], 0, totalSize * sizeof(uint32_t));
+}
+
+// Returns the size of the levels of a set for ranks less than the specified size
+size_t SuffixArrayMatchFinder::RankSet::getMemorySize(int size)
+{
+	size_t totalSize = 0;
+	int bitCount = size;
+
+	do
+	{
+		bitCount = (bitCount + 31) / 32;
+		totalSize += bitCount;
+	}
+	while (bitCount > 1);
+
+	return totalSize * sizeof(uint32_t);
+}
+
+void SuffixArrayMatchFinder::RankSet::insert(int rank)
+{
+	for (int level = 0; level < levelCount_; ++level)
+	{
+		uint32_t& word = levels_[level][rank >> 5];
+		bool wasEmpty = (word == 0);
+		word |= 1u << (rank & 31);
+
+		// The higher levels are already marked if the word was not empty
+		if (!wasEmpty)
+		{
+			break;
+		}
+
+		rank >>= 5;
+	}
+}
+
+void SuffixArrayMatchFinder::RankSet::erase(int rank)
+{
+	for (int level = 0; level < levelCount_; ++level)
+	{
+		uint32_t& word = levels_[level][rank >> 5];
+		word &= ~(1u << (rank & 31));
+
+		// The higher levels must be cleared only if the word has become empty
+		if (word != 0)
+		{
+			break;
+		}
+
+		rank >>= 5;
+	}
+}
+
+int SuffixArrayMatchFinder::RankSet::findPredecessor(int rank) const
+{
+	// Go up until there is a lower bit in the word
+	int level = 0;
+
+	for (; ;)
+	{
+		uint32_t bits = levels_[level][rank >> 5] & ((1u << (rank & 31)) - 1);
+
+		if (bits != 0)
+		{
+			rank = (rank & ~31) | getHighestBit(bits);
+			break;
+		}
+
+		if (++level == levelCount_)
+		{
+			return -1;
+		}
+
+		rank >>= 5;
+	}
+
+	// Go down to the highest bit of the word
+	while (level > 0)
+	{
+		--level;
+		rank = (rank << 5) | getHighestBit(levels_[level][rank]);
+	}
+
+	return rank;
+}
+
+int SuffixArrayMatchFinder::RankSet::findSuccessor(int rank) const
+{
+	// Go up until there is a higher bit in the word
+	int level = 0;
+
+	for (; ;)
+	{
+		uint32_t bits = levels_[level][rank >> 5] & ~((2u << (rank & 31)) - 1);
+
+		if (bits != 0)
+		{
+			rank = (rank & ~31) | getLowestBit(bits);
+			break;
+		}
+
+		if (++level == levelCount_)
+		{
+			return -1;
+		}
+
+		rank >>= 5;
+	}
+
+	// Go down to the lowest bit of the word
+	while (level > 0)
+	{
+		--level;
+		rank = (rank << 5) | getLowestBit(levels_[level][rank]);
+	}
+
+	return rank;
+}
+
+} // namespace detail
+} // namespace doboz
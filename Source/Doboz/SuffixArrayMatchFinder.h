@@ -0,0 +1,141 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#include "Common.h"
+
+namespace doboz {
+namespace detail {
+
+// Match finder based on suffix arrays, which always finds the longest matches in the window (up to MAX_MATCH_LENGTH)
+// It has the same interface as Dictionary, but it is much slower and needs more memory
+// The buffer is processed in blocks, and the suffix array of every block and the window before it is built separately
+// The suffix arrays of multiple blocks are built in parallel, on up to the specified number of threads
+class SuffixArrayMatchFinder
+{
+public:
+	explicit SuffixArrayMatchFinder(int windowSizeLog = DEFAULT_WINDOW_SIZE_LOG, int threadCount = 1);
+	~SuffixArrayMatchFinder();
+
+	void setBuffer(const uint8_t* buffer, size_t bufferLength);
+
+	// Allocates the memory needed for buffers up to the specified length, and touches all of it
+	void reserve(size_t maxBufferLength);
+
+	// Returns the approximate size of the memory used for a buffer with the specified length
+	// This includes the temporary memory used for building the suffix arrays
+	static size_t getMemorySize(int windowSizeLog, int threadCount, size_t bufferLength);
+
+	int findMatches(Match* matchCandidates);
+	void skip();
+	void jump(size_t count);
+
+	size_t position() const
+	{
+		return position_;
+	}
+
+	int windowSizeLog() const
+	{
+		return windowSizeLog_;
+	}
+
+private:
+	static const int MIN_BLOCK_SIZE = 1 << 22;
+	static const int MAX_THREAD_COUNT = 8; // limits the memory usage
+
+	// A block of the buffer and the text of its suffix array
+	// The text starts with the window of the first position in the block, and ends after the longest match from the last position
+	struct Segment
+	{
+		const uint8_t* buffer;
+		size_t blockStart;
+		size_t blockEnd;
+		size_t textStart;
+		size_t textEnd;
+		int* suffixArray;
+		int capacity;
+	};
+
+	// Set of suffix ranks with fast predecessor and successor queries
+	// It consists of bitmap levels, every bit of a level marks whether the corresponding word of the lower level is not empty
+	class RankSet
+	{
+	public:
+		RankSet();
+		~RankSet();
+
+		void reset(int size);
+
+		void insert(int rank);
+		void erase(int rank);
+
+		int findPredecessor(int rank) const; // the largest rank less than the specified one, or -1
+		int findSuccessor(int rank) const; // the smallest rank greater than the specified one, or -1
+
+		static size_t getMemorySize(int size);
+
+	private:
+		static const int MAX_LEVEL_COUNT = 7;
+
+		uint32_t* levels_[MAX_LEVEL_COUNT];
+		int levelSizes_[MAX_LEVEL_COUNT]; // in words
+		int levelCount_;
+		int capacity_;
+	};
+
+	int windowSizeLog_;
+	int windowSize_;
+	int blockSize_;
+	int threadCount_;
+
+	// Buffer
+	const uint8_t* buffer_;
+	size_t bufferLength_;
+	size_t matchableBufferLength_;
+	size_t position_;
+
+	// Segments, which are built in batches
+	Segment segments_[MAX_THREAD_COUNT];
+	int segmentCount_; // in the current batch
+	int segmentIndex_; // the current segment in the batch, or -1
+	size_t nextBlockStart_;
+
+	// The ranks of the suffixes of the current segment, and the ranks of the window
+	int* ranks_;
+	int rankCapacity_;
+	RankSet window_;
+
+	static void getSegmentSizes(int windowSizeLog, int threadCount, size_t bufferLength, int& segmentCount, int& maxTextLength);
+
+	const Segment& getSegment();
+	void buildSegments();
+	static void buildSegment(void* segment);
+	void loadSegment(const Segment& segment);
+	void slideWindow(const Segment& segment);
+
+	int getMatchLength(size_t matchPosition, int maxMatchLength) const;
+
+	// Non-copyable
+	SuffixArrayMatchFinder(const SuffixArrayMatchFinder&);
+	SuffixArrayMatchFinder& operator =(const SuffixArrayMatchFinder&);
+};
+
+} // namespace detail
+} // namespace doboz
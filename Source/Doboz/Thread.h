@@ -0,0 +1,314 @@
+/*
+ * Doboz Data Compression Library
+ * Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>
+ * 
+ * This software is provided 'as-is', without any express or implied warranty. In no event will
+ * the authors be held liable for any damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose, including commercial
+ * applications, and to alter it and redistribute it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not claim that you wrote the
+ *    original software. If you use this software in a product, an acknowledgment in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+ *    being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include <cassert>
+
+namespace doboz {
+namespace detail {
+
+// Minimal platform independent thread
+class Thread
+{
+public:
+	typedef void (*Function)(void* argument);
+
+	Thread()
+		: isRunning_(false)
+	{
+	}
+
+	~Thread()
+	{
+		join();
+	}
+
+	// Runs the function with the argument on a new thread
+	// If the thread cannot be created, runs the function on the current thread
+	void start(Function function, void* argument)
+	{
+		if (!tryStart(function, argument))
+		{
+			function(argument);
+		}
+	}
+
+	// Runs the function with the argument on a new thread
+	// Returns false if the thread cannot be created
+	bool tryStart(Function function, void* argument)
+	{
+		assert(!isRunning_ && "The thread is already running.");
+
+		function_ = function;
+		argument_ = argument;
+
+#ifdef _WIN32
+		handle_ = CreateThread(0, 0, run, this, 0, 0);
+		isRunning_ = (handle_ != 0);
+#else
+		isRunning_ = (pthread_create(&handle_, 0, run, this) == 0);
+#endif
+
+		return isRunning_;
+	}
+
+	// Waits for the thread to finish
+	void join()
+	{
+		if (!isRunning_)
+		{
+			return;
+		}
+
+#ifdef _WIN32
+		WaitForSingleObject(handle_, INFINITE);
+		CloseHandle(handle_);
+#else
+		pthread_join(handle_, 0);
+#endif
+
+		isRunning_ = false;
+	}
+
+	static int getProcessorCount()
+	{
+#ifdef _WIN32
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		int processorCount = static_cast<int>(systemInfo.dwNumberOfProcessors);
+#else
+		int processorCount = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+
+		return (processorCount > 0) ? processorCount : 1;
+	}
+
+	// Gives up the rest of the time slice of the current thread
+	static void yield()
+	{
+#ifdef _WIN32
+		SwitchToThread();
+#else
+		sched_yield();
+#endif
+	}
+
+private:
+	Function function_;
+	void* argument_;
+	bool isRunning_;
+
+#ifdef _WIN32
+	HANDLE handle_;
+
+	static DWORD WINAPI run(LPVOID thread)
+	{
+		static_cast<Thread*>(thread)->function_(static_cast<Thread*>(thread)->argument_);
+		return 0;
+	}
+#else
+	pthread_t handle_;
+
+	static void* run(void* thread)
+	{
+		static_cast<Thread*>(thread)->function_(static_cast<Thread*>(thread)->argument_);
+		return 0;
+	}
+#endif
+
+	// Non-copyable
+	Thread(const Thread&);
+	Thread& operator =(const Thread&);
+};
+
+// Minimal platform independent mutex
+class Mutex
+{
+public:
+	Mutex()
+	{
+#ifdef _WIN32
+		InitializeCriticalSection(&handle_);
+#else
+		pthread_mutex_init(&handle_, 0);
+#endif
+	}
+
+	~Mutex()
+	{
+#ifdef _WIN32
+		DeleteCriticalSection(&handle_);
+#else
+		pthread_mutex_destroy(&handle_);
+#endif
+	}
+
+	void lock()
+	{
+#ifdef _WIN32
+		EnterCriticalSection(&handle_);
+#else
+		pthread_mutex_lock(&handle_);
+#endif
+	}
+
+	void unlock()
+	{
+#ifdef _WIN32
+		LeaveCriticalSection(&handle_);
+#else
+		pthread_mutex_unlock(&handle_);
+#endif
+	}
+
+private:
+#ifdef _WIN32
+	CRITICAL_SECTION handle_;
+#else
+	pthread_mutex_t handle_;
+#endif
+
+	// Non-copyable
+	Mutex(const Mutex&);
+	Mutex& operator =(const Mutex&);
+};
+
+// Minimal platform independent auto-reset event
+// A thread waiting for the event is blocked until another thread sets it, and the event is reset when the wait returns
+// If the event is already set, the wait returns immediately
+class Event
+{
+public:
+	Event()
+	{
+#ifdef _WIN32
+		handle_ = CreateEvent(0, FALSE, FALSE, 0);
+#else
+		isSet_ = false;
+		pthread_mutex_init(&mutex_, 0);
+		pthread_cond_init(&condition_, 0);
+#endif
+	}
+
+	~Event()
+	{
+#ifdef _WIN32
+		CloseHandle(handle_);
+#else
+		pthread_cond_destroy(&condition_);
+		pthread_mutex_destroy(&mutex_);
+#endif
+	}
+
+	void set()
+	{
+#ifdef _WIN32
+		SetEvent(handle_);
+#else
+		pthread_mutex_lock(&mutex_);
+		isSet_ = true;
+		pthread_cond_signal(&condition_);
+		pthread_mutex_unlock(&mutex_);
+#endif
+	}
+
+	void wait()
+	{
+#ifdef _WIN32
+		WaitForSingleObject(handle_, INFINITE);
+#else
+		pthread_mutex_lock(&mutex_);
+		while (!isSet_)
+		{
+			pthread_cond_wait(&condition_, &mutex_);
+		}
+		isSet_ = false;
+		pthread_mutex_unlock(&mutex_);
+#endif
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE handle_;
+#else
+	bool isSet_;
+	pthread_mutex_t mutex_;
+	pthread_cond_t condition_;
+#endif
+
+	// Non-copyable
+	Event(const Event&);
+	Event& operator =(const Event&);
+};
+
+// Reads a variable written by another thread with atomicStore
+// Everything the other thread wrote before storing the value is visible after loading it
+template <typename T>
+inline T atomicLoad(const volatile T& variable)
+{
+#ifdef _WIN32
+	T value = variable; // volatile reads have acquire semantics
+	_ReadWriteBarrier();
+	return value;
+#else
+	return __atomic_load_n(&variable, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Writes a variable read by another thread with atomicLoad
+template <typename T>
+inline void atomicStore(volatile T& variable, T value)
+{
+#ifdef _WIN32
+	_ReadWriteBarrier();
+	variable = value; // volatile writes have release semantics
+#else
+	__atomic_store_n(&variable, value, __ATOMIC_RELEASE);
+#endif
+}
+
+// Adds a value to a variable shared by multiple threads, and returns its previous value
+inline size_t atomicFetchAdd(volatile size_t& variable, size_t value)
+{
+#if defined(_WIN64)
+	return static_cast<size_t>(InterlockedExchangeAdd64(reinterpret_cast<volatile LONGLONG*>(&variable), static_cast<LONGLONG>(value)));
+#elif defined(_WIN32)
+	return static_cast<size_t>(InterlockedExchangeAdd(reinterpret_cast<volatile LONG*>(&variable), static_cast<LONG>(value)));
+#else
+	return __atomic_fetch_add(&variable, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+} // namespace detail
+} // namespace doboz
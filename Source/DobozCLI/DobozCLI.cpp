@@ -17,6 +17,7 @@
  */
 
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include "Doboz/Compressor.h"
 #include "Doboz/Decompressor.h"
@@ -107,7 +108,7 @@ void cleanup()
 
 void printUsage()
 {
-	cout << "Usage: doboz c|d input output" << endl;
+	cout << "Usage: doboz c|d input output [window size log]" << endl;
 }
 
 int main(int argc, char* argv[])
@@ -116,15 +117,22 @@ int main(int argc, char* argv[])
 	cout << "Copyright (C) 2010-2011 Attila T. Afra <attila.afra@gmail.com>" << endl;
 	cout << endl;
 
-	if (argc != 4)
+	if (argc != 4 && argc != 5)
 	{
-		cout << "Usage: doboz c|d input output" << endl;
+		printUsage();
 		return 0;
 	}
 
 	if (toupper(argv[1][0]) == 'C')
 	{
 		// Compress
+		int windowSizeLog = (argc == 5) ? atoi(argv[4]) : doboz::DEFAULT_WINDOW_SIZE_LOG;
+		if (windowSizeLog < doboz::MIN_WINDOW_SIZE_LOG || windowSizeLog > doboz::MAX_WINDOW_SIZE_LOG)
+		{
+			cout << "ERROR: The window size log must be between " << doboz::MIN_WINDOW_SIZE_LOG << " and " << doboz::MAX_WINDOW_SIZE_LOG << endl;
+			return 1;
+		}
+
 		if (!loadInputFile(argv[2]))
 		{
 			cleanup();
@@ -135,7 +143,7 @@ int main(int argc, char* argv[])
 		outputBuffer = new char[outputBufferSize];
 
 		cout << "Compressing..." << endl;
-		doboz::Compressor compressor;
+		doboz::Compressor compressor(windowSizeLog);
 		Timer timer;
 		doboz::Result result = compressor.compress(inputBuffer, inputSize, outputBuffer, outputBufferSize, outputSize);
 		double compressionTime = timer.query();
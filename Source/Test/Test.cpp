@@ -20,6 +20,7 @@
 #include <cstring>
 #include <iostream>
 #include <algorithm>
+#include <vector>
 #include "Doboz/Compressor.h"
 #include "Doboz/Decompressor.h"
 #include "Utils/Timer.h"
@@ -157,10 +158,416 @@ bool basicTest()
 		return false;
 	}
 
+	// The pooled compressor must give the same result
+	size_t pooledCompressedSize;
+	result = doboz::compress(originalBuffer, originalSize, tempCompressedBuffer, compressedBufferSize, pooledCompressedSize);
+	if (result != doboz::RESULT_OK || pooledCompressedSize != compressedSize || memcmp(compressedBuffer, tempCompressedBuffer, compressedSize) != 0)
+	{
+		cout << "Pooled encoding FAILED" << endl;
+		return false;
+	}
+
+	// The compression must stop if the destination is smaller than the compressed data, and give the same result if it is slightly larger
+	size_t limitedCompressedSize;
+	result = compressor.compress(originalBuffer, originalSize, tempCompressedBuffer, compressedSize - 1, limitedCompressedSize);
+	if (result != doboz::RESULT_ERROR_COMPRESSED_DATA_TOO_LARGE)
+	{
+		cout << "Limited encoding FAILED" << endl;
+		return false;
+	}
+
+	result = compressor.compress(originalBuffer, originalSize, tempCompressedBuffer, compressedSize + 64, limitedCompressedSize);
+	if (result != doboz::RESULT_OK || limitedCompressedSize != compressedSize || memcmp(compressedBuffer, tempCompressedBuffer, compressedSize) != 0)
+	{
+		cout << "Limited encoding FAILED" << endl;
+		return false;
+	}
+
+	// The data split into chunks must be compressed the same way as the contiguous data
+	doboz::SourceChunk chunks[4];
+	chunks[0].data = originalBuffer;
+	chunks[0].size = originalSize / 3;
+	chunks[1].data = originalBuffer + chunks[0].size;
+	chunks[1].size = 0;
+	chunks[2].data = chunks[1].data;
+	chunks[2].size = originalSize / 2;
+	chunks[3].data = originalBuffer + chunks[0].size + chunks[2].size;
+	chunks[3].size = originalSize - chunks[0].size - chunks[2].size;
+
+	size_t gatheredCompressedSize;
+	result = compressor.compress(chunks, 4, tempCompressedBuffer, compressedBufferSize, gatheredCompressedSize);
+	if (result != doboz::RESULT_OK || gatheredCompressedSize != compressedSize || memcmp(compressedBuffer, tempCompressedBuffer, compressedSize) != 0)
+	{
+		cout << "Chunked encoding FAILED" << endl;
+		return false;
+	}
+
+	// The chunks are copied into a buffer, which must be included in the memory usage
+	if (compressor.getMemoryUsage(originalSize, true) < compressor.getMemoryUsage(originalSize) + originalSize)
+	{
+		cout << "Chunked memory usage FAILED" << endl;
+		return false;
+	}
+
+	// The estimated compressed size must not exceed the size of the stored data
+	double estimatedRatio = compressor.estimate(originalBuffer, originalSize);
+	cout << "Estimated compression ratio: " << estimatedRatio * 100.0 << "%, actual: " << static_cast<double>(compressedSize) / static_cast<double>(originalSize) * 100.0 << "%" << endl;
+	if (estimatedRatio <= 0.0 || estimatedRatio * static_cast<double>(originalSize) > static_cast<double>(doboz::Compressor::getMaxCompressedSize(originalSize)))
+	{
+		cout << "Estimation FAILED" << endl;
+		return false;
+	}
+
+	// The hash table of the estimation is reused without clearing it, which must not change the result
+	if (compressor.estimate(originalBuffer, originalSize) != estimatedRatio)
+	{
+		cout << "Repeated estimation FAILED" << endl;
+		return false;
+	}
+
 	cout << "Decoding and verification successful" << endl;
 	return true;
 }
 
+// Compresses the data a few times with automatic level selection, and checks the final level
+bool tunedCompressionTest(doboz::Compressor& compressor, doboz::CompressionLevel expectedLevel)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		doboz::Result result = compressor.compress(originalBuffer, originalSize, compressedBuffer, compressedBufferSize, compressedSize);
+		if (result != doboz::RESULT_OK)
+		{
+			cout << "Encoding FAILED" << endl;
+			return false;
+		}
+
+		prepareDecompression();
+		if (!decompress())
+		{
+			cout << "Decoding/verification FAILED" << endl;
+			return false;
+		}
+	}
+
+	if (compressor.getLevel() != expectedLevel)
+	{
+		cout << "Level selection FAILED" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool parameterTest()
+{
+	cout << "Compression parameter test" << endl;
+
+	const int windowSizeLogs[] = {doboz::MIN_WINDOW_SIZE_LOG, 24, 24, doboz::MIN_WINDOW_SIZE_LOG, doboz::DEFAULT_WINDOW_SIZE_LOG, doboz::MIN_WINDOW_SIZE_LOG, 17, doboz::DEFAULT_WINDOW_SIZE_LOG, doboz::MIN_WINDOW_SIZE_LOG,
+		doboz::MIN_WINDOW_SIZE_LOG, 24};
+	const bool longDistanceMatchings[] = {false, false, true, false, false, false, true, false, false, false, true};
+	const doboz::MatchFinderType matchFinderTypes[] = {doboz::MATCH_FINDER_BINARY_TREE, doboz::MATCH_FINDER_BINARY_TREE, doboz::MATCH_FINDER_BINARY_TREE,
+		doboz::MATCH_FINDER_SUFFIX_ARRAY, doboz::MATCH_FINDER_SUFFIX_ARRAY, doboz::MATCH_FINDER_BINARY_TREE, doboz::MATCH_FINDER_BINARY_TREE,
+		doboz::MATCH_FINDER_BINARY_TREE, doboz::MATCH_FINDER_SUFFIX_ARRAY, doboz::MATCH_FINDER_HASH_CHAIN, doboz::MATCH_FINDER_HASH_CHAIN};
+	const int threadCounts[] = {1, 1, 1, 1, 1, 4, 3, 2, 2, 1, 1};
+
+	for (size_t i = 0; i < sizeof(windowSizeLogs) / sizeof(windowSizeLogs[0]); ++i)
+	{
+		cout << "Window size log: " << windowSizeLogs[i] << (longDistanceMatchings[i] ? ", long-distance matching" : "") <<
+			(matchFinderTypes[i] == doboz::MATCH_FINDER_SUFFIX_ARRAY ? ", suffix array" : "") << (matchFinderTypes[i] == doboz::MATCH_FINDER_HASH_CHAIN ? ", hash chain" : "") <<
+			", threads: " << threadCounts[i] << endl;
+
+		doboz::Compressor compressor(windowSizeLogs[i], longDistanceMatchings[i], matchFinderTypes[i], threadCounts[i]);
+		compressor.reserve(originalSize);
+		doboz::Result result = compressor.compress(originalBuffer, originalSize, compressedBuffer, compressedBufferSize, compressedSize);
+		if (result != doboz::RESULT_OK)
+		{
+			cout << "Encoding FAILED" << endl;
+			return false;
+		}
+
+		prepareDecompression();
+		if (!decompress())
+		{
+			cout << "Decoding/verification FAILED" << endl;
+			return false;
+		}
+	}
+
+	// The test data may be too small to be split into segments, so a large block is generated, which is split with the smallest window
+	// It consists of words selected randomly from a small vocabulary, so there are matches across the segment boundaries
+	const char* const words[] = {"doboz ", "window ", "segment ", "match ", "literal ", "thread ", "dictionary ", "block ", "\n"};
+	const int wordCount = sizeof(words) / sizeof(words[0]);
+	const size_t segmentedSize = 2 * 1024 * 1024;
+
+	vector<char> segmentedBuffer;
+	segmentedBuffer.reserve(segmentedSize + 16);
+	FastRng rng;
+	while (segmentedBuffer.size() < segmentedSize)
+	{
+		const char* word = words[rng.getUint() % wordCount];
+		segmentedBuffer.insert(segmentedBuffer.end(), word, word + strlen(word));
+	}
+
+	vector<char> segmentedCompressedBuffer(static_cast<size_t>(doboz::Compressor::getMaxCompressedSize(segmentedBuffer.size())));
+	vector<char> segmentedDecompressedBuffer(segmentedBuffer.size());
+	const bool segmentedLongDistanceMatchings[] = {false, true};
+	const int segmentedThreadCounts[] = {4, 3};
+
+	for (size_t i = 0; i < sizeof(segmentedThreadCounts) / sizeof(segmentedThreadCounts[0]); ++i)
+	{
+		cout << "Segmented block, window size log: " << doboz::MIN_WINDOW_SIZE_LOG << (segmentedLongDistanceMatchings[i] ? ", long-distance matching" : "") <<
+			", threads: " << segmentedThreadCounts[i] << endl;
+
+		doboz::Compressor compressor(doboz::MIN_WINDOW_SIZE_LOG, segmentedLongDistanceMatchings[i], doboz::MATCH_FINDER_BINARY_TREE, segmentedThreadCounts[i]);
+		size_t segmentedCompressedSize;
+		doboz::Result result = compressor.compress(&segmentedBuffer[0], segmentedBuffer.size(), &segmentedCompressedBuffer[0], segmentedCompressedBuffer.size(), segmentedCompressedSize);
+		if (result != doboz::RESULT_OK)
+		{
+			cout << "Encoding FAILED" << endl;
+			return false;
+		}
+
+		doboz::Decompressor decompressor;
+		result = decompressor.decompress(&segmentedCompressedBuffer[0], segmentedCompressedSize, &segmentedDecompressedBuffer[0], segmentedDecompressedBuffer.size());
+		if (result != doboz::RESULT_OK || segmentedDecompressedBuffer != segmentedBuffer)
+		{
+			cout << "Decoding/verification FAILED" << endl;
+			return false;
+		}
+	}
+
+	// The fast decompression level does not use the other threads, so it must not reserve their match finders
+	doboz::Compressor singleThreadedCompressor(doboz::COMPRESSION_LEVEL_FAST_DECOMPRESSION);
+	doboz::Compressor multiThreadedCompressor(doboz::COMPRESSION_LEVEL_FAST_DECOMPRESSION, 4);
+	if (multiThreadedCompressor.getMemoryUsage(segmentedBuffer.size()) != singleThreadedCompressor.getMemoryUsage(segmentedBuffer.size()))
+	{
+		cout << "Memory usage FAILED" << endl;
+		return false;
+	}
+
+	const size_t memoryBudgets[] = {256 * 1024, 4 * 1024 * 1024, 32 * 1024 * 1024};
+
+	for (size_t i = 0; i < sizeof(memoryBudgets) / sizeof(memoryBudgets[0]); ++i)
+	{
+		cout << "Memory budget: " << memoryBudgets[i] / 1024 << " KB" << endl;
+
+		doboz::Compressor compressor((doboz::MemoryBudget(memoryBudgets[i])));
+		if (compressor.getMemoryUsage(originalSize) > memoryBudgets[i])
+		{
+			cout << "Memory budget FAILED" << endl;
+			return false;
+		}
+
+		doboz::Result result = compressor.compress(originalBuffer, originalSize, compressedBuffer, compressedBufferSize, compressedSize);
+		if (result != doboz::RESULT_OK)
+		{
+			cout << "Encoding FAILED" << endl;
+			return false;
+		}
+
+		prepareDecompression();
+		if (!decompress())
+		{
+			cout << "Decoding/verification FAILED" << endl;
+			return false;
+		}
+
+		// The hash table of the estimation is included in the memory usage, and its size depends on the budget
+		if (compressor.estimate(originalBuffer, originalSize) <= 0.0)
+		{
+			cout << "Estimation FAILED" << endl;
+			return false;
+		}
+	}
+
+	const doboz::CompressionLevel levels[] = {doboz::COMPRESSION_LEVEL_FASTEST, doboz::COMPRESSION_LEVEL_FAST, doboz::COMPRESSION_LEVEL_DEFAULT, doboz::COMPRESSION_LEVEL_MAX,
+		doboz::COMPRESSION_LEVEL_FAST_DECOMPRESSION};
+
+	for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); ++i)
+	{
+		cout << "Compression level: " << levels[i] << endl;
+
+		doboz::Compressor compressor(levels[i]);
+		compressor.reserve(originalSize, levels[i]);
+		doboz::Result result = compressor.compress(originalBuffer, originalSize, compressedBuffer, compressedBufferSize, compressedSize);
+		if (result != doboz::RESULT_OK)
+		{
+			cout << "Encoding FAILED" << endl;
+			return false;
+		}
+
+		prepareDecompression();
+		if (!decompress())
+		{
+			cout << "Decoding/verification FAILED" << endl;
+			return false;
+		}
+	}
+
+	// The unreachable targets must keep the level at the fastest or the best one, and the trivial target must reach the best one
+	cout << "Throughput target" << endl;
+	doboz::Compressor fastCompressor((doboz::ThroughputTarget(1.0e9)));
+	doboz::Compressor slowCompressor((doboz::ThroughputTarget(1.0e-3)));
+	if (!tunedCompressionTest(fastCompressor, doboz::COMPRESSION_LEVEL_FASTEST) || !tunedCompressionTest(slowCompressor, doboz::COMPRESSION_LEVEL_DEFAULT))
+	{
+		return false;
+	}
+
+	// The memory of every selectable level is reserved, so it must be more than the memory of the default level alone
+	doboz::Compressor defaultCompressor(doboz::COMPRESSION_LEVEL_DEFAULT);
+	if (fastCompressor.getMemoryUsage(originalSize) <= defaultCompressor.getMemoryUsage(originalSize))
+	{
+		cout << "Memory usage FAILED" << endl;
+		return false;
+	}
+
+	cout << "Ratio target" << endl;
+	doboz::Compressor ratioCompressor((doboz::RatioTarget(1.0e-9)));
+	if (!tunedCompressionTest(ratioCompressor, doboz::COMPRESSION_LEVEL_DEFAULT))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool sequenceTest()
+{
+	cout << "Sequence test" << endl;
+
+	size_t maxSequenceCount = doboz::Compressor::getMaxSequenceCount(originalSize);
+	doboz::Sequence* sequences = new doboz::Sequence[maxSequenceCount];
+	size_t sequenceCount;
+
+	doboz::Compressor compressor;
+	doboz::Result result = compressor.findSequences(originalBuffer, originalSize, sequences, maxSequenceCount, sequenceCount);
+	if (result != doboz::RESULT_OK || sequences[sequenceCount - 1].matchLength != 0)
+	{
+		cout << "Parsing FAILED" << endl;
+		delete[] sequences;
+		return false;
+	}
+
+	// Rebuild the data from the sequences
+	memset(decompressedBuffer, 0, originalSize);
+	size_t position = 0;
+	bool ok = true;
+
+	for (size_t i = 0; i < sequenceCount && ok; ++i)
+	{
+		const doboz::Sequence& sequence = sequences[i];
+
+		if (sequence.literalLength + sequence.matchLength > originalSize - position || static_cast<size_t>(sequence.offset) > position + sequence.literalLength)
+		{
+			ok = false;
+			break;
+		}
+
+		memcpy(decompressedBuffer + position, originalBuffer + position, sequence.literalLength);
+		position += sequence.literalLength;
+
+		for (int j = 0; j < sequence.matchLength; ++j)
+		{
+			decompressedBuffer[position] = decompressedBuffer[position - sequence.offset];
+			++position;
+		}
+	}
+
+	if (!ok || position != originalSize || !verifyDecompressed())
+	{
+		cout << "Verification FAILED" << endl;
+		delete[] sequences;
+		return false;
+	}
+
+	// Encoding the sequences must give the same result as the compressor
+	result = compressor.compress(originalBuffer, originalSize, compressedBuffer, compressedBufferSize, compressedSize);
+	size_t sequencesCompressedSize;
+	result = (result == doboz::RESULT_OK) ? compressor.compressSequences(originalBuffer, originalSize, sequences, sequenceCount, tempCompressedBuffer, compressedBufferSize, sequencesCompressedSize) : result;
+
+	delete[] sequences;
+
+	if (result != doboz::RESULT_OK || sequencesCompressedSize != compressedSize || memcmp(compressedBuffer, tempCompressedBuffer, compressedSize) != 0)
+	{
+		cout << "Encoding FAILED" << endl;
+		return false;
+	}
+
+	memset(decompressedBuffer, 0, originalSize);
+	if (!decompress())
+	{
+		cout << "Decoding/verification FAILED" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool batchTest()
+{
+	cout << "Batch test" << endl;
+
+	// Split the data into small blocks
+	const size_t blockSize = 4 * KILOBYTE;
+	size_t blockCount = (originalSize + blockSize - 1) / blockSize;
+	size_t maxCompressedBlockSize = static_cast<size_t>(doboz::Compressor::getMaxCompressedSize(blockSize));
+
+	vector<const void*> sources(blockCount);
+	vector<size_t> sourceSizes(blockCount);
+	vector<char> destinationBuffer(blockCount * maxCompressedBlockSize);
+	vector<void*> destinations(blockCount);
+	vector<size_t> destinationSizes(blockCount, maxCompressedBlockSize);
+	vector<size_t> compressedSizes(blockCount);
+
+	for (size_t i = 0; i < blockCount; ++i)
+	{
+		sources[i] = originalBuffer + i * blockSize;
+		sourceSizes[i] = min(blockSize, originalSize - i * blockSize);
+		destinations[i] = &destinationBuffer[i * maxCompressedBlockSize];
+	}
+
+	doboz::Compressor compressor;
+	doboz::Result result = compressor.compressBatch(&sources[0], &sourceSizes[0], &destinations[0], &destinationSizes[0], &compressedSizes[0], blockCount);
+	if (result != doboz::RESULT_OK)
+	{
+		cout << "Encoding FAILED" << endl;
+		return false;
+	}
+
+	// Decompress the blocks in a batch too
+	vector<void*> decompressedBlocks(blockCount);
+	vector<doboz::Result> results(blockCount);
+
+	for (size_t i = 0; i < blockCount; ++i)
+	{
+		decompressedBlocks[i] = decompressedBuffer + i * blockSize;
+	}
+
+	// The threads of the first batch are reused by the next ones, which may need more threads
+	doboz::Decompressor decompressor;
+	const int threadCounts[] = {4, 2, 6};
+
+	for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); ++i)
+	{
+		memset(decompressedBuffer, 0, originalSize);
+
+		result = decompressor.decompressBatch(&destinations[0], &compressedSizes[0], &decompressedBlocks[0], &sourceSizes[0], &results[0], blockCount, threadCounts[i]);
+		if (result != doboz::RESULT_OK)
+		{
+			cout << "Decoding FAILED" << endl;
+			return false;
+		}
+
+		if (!verifyDecompressed())
+		{
+			cout << "Verification FAILED" << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
 bool corruptionTest()
 {
 	FastRng rng;
@@ -235,6 +642,142 @@ bool incrementalTest()
 	return true;
 }
 
+// Streams compressed from the golden payload with the default parameters of each earlier format version
+const unsigned char goldenStreamVersion0[] =
+{
+	0x08, 0x00, 0x04, 0xb1, 0x00, 0x00, 0x00, 0x00, 0x80, 0x54, 0x68, 0x65, 0x20, 0x71, 0x75, 0x69,
+	0x63, 0x6b, 0x20, 0x62, 0x72, 0x6f, 0x77, 0x6e, 0x20, 0x66, 0x6f, 0x78, 0x20, 0x6a, 0x75, 0x6d,
+	0x70, 0x73, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x02, 0x10, 0xef, 0x80, 0x74, 0x7c, 0x6c, 0x61,
+	0x7a, 0x79, 0x20, 0x64, 0x6f, 0x67, 0x2e, 0x20, 0x76, 0x0b, 0x63, 0x61, 0x74, 0x93, 0x2d, 0x00,
+	0x15, 0x01, 0x7e, 0x0b, 0x0f, 0xd5, 0x02, 0x00, 0x7a, 0xff, 0x0f, 0x00, 0x00, 0xff, 0x0f, 0x00,
+	0x00, 0x87, 0x0a, 0x00, 0x00, 0x41, 0x96, 0x27, 0xc4, 0xf9, 0x95, 0xd9, 0x00, 0x00, 0x00, 0x80,
+	0x9c, 0xbf, 0x0f, 0x0a, 0x31, 0x23, 0xaf, 0x7d, 0xc4, 0xe2, 0xd2, 0xe2, 0xe3, 0xe9, 0x93, 0x50,
+	0x28, 0x2c, 0x75, 0x42, 0xb3, 0x4d, 0xe4, 0xf7, 0xef, 0xee, 0x56, 0xe1, 0xca, 0x31, 0xad, 0x00,
+	0x00, 0x00, 0x84, 0x99, 0x69, 0xb5, 0x3b, 0x7d, 0x10, 0x1b, 0x7a, 0xde, 0xb4, 0xe3, 0x61, 0x7a,
+	0x83, 0x28, 0xe0, 0x9f, 0x4b, 0x85, 0xfa, 0x28, 0x87, 0x38, 0x75, 0x49, 0x8f, 0x7f, 0x92, 0x17,
+	0x00, 0x7a, 0x79, 0x20, 0x66, 0x00, 0x00, 0x00, 0x80, 0x6f, 0x78, 0x2e, 0x20, 0x00, 0x00, 0x00,
+	0x00
+};
+
+const unsigned char goldenStreamVersion1[] =
+{
+	0x09, 0x00, 0x04, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x88, 0x77, 0x80, 0x54, 0x68, 0x65,
+	0x20, 0x71, 0x75, 0x69, 0x63, 0x6b, 0x20, 0x62, 0x72, 0x6f, 0x77, 0x6e, 0x20, 0x66, 0x6f, 0x78,
+	0x20, 0x6a, 0x75, 0x6d, 0x70, 0x73, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x7c, 0x6c, 0x61,
+	0x7a, 0x79, 0x20, 0x64, 0x6f, 0x67, 0x2e, 0x20, 0x76, 0x0b, 0x63, 0x61, 0x74, 0x93, 0x2d, 0x00,
+	0x15, 0x01, 0x7e, 0x0b, 0x0f, 0xd5, 0x02, 0x00, 0x7a, 0xff, 0x0f, 0x00, 0x00, 0xff, 0x0f, 0x00,
+	0x00, 0x87, 0x0a, 0x00, 0x00, 0x41, 0x96, 0x27, 0xc4, 0xf9, 0x95, 0xd9, 0x9c, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x81, 0xbf, 0x0f, 0x0a, 0x31, 0x23, 0xaf, 0x7d, 0xc4, 0xe2, 0xd2, 0xe2,
+	0xe3, 0xe9, 0x93, 0x50, 0x28, 0x2c, 0x75, 0x42, 0xb3, 0x4d, 0xe4, 0xf7, 0xef, 0xee, 0x56, 0xe1,
+	0xca, 0x31, 0xad, 0x99, 0x69, 0xb5, 0x3b, 0x7d, 0x10, 0x1b, 0x7a, 0xde, 0xb4, 0xe3, 0x61, 0x7a,
+	0x83, 0x28, 0xe0, 0x9f, 0x4b, 0x85, 0xfa, 0x28, 0x87, 0x38, 0x75, 0x49, 0x8f, 0x7f, 0x92, 0x17,
+	0x00, 0x7a, 0x79, 0x20, 0x66, 0x6f, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x2e,
+	0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+const unsigned char goldenStreamVersion2[] =
+{
+	0x0a, 0x00, 0x04, 0xad, 0x00, 0x03, 0x10, 0xef, 0x03, 0x00, 0x00, 0x00, 0x80, 0x00, 0x20, 0x54,
+	0x68, 0x65, 0x20, 0x71, 0x75, 0x69, 0x63, 0x6b, 0x20, 0x62, 0x72, 0x6f, 0x77, 0x6e, 0x20, 0x66,
+	0x6f, 0x78, 0x20, 0x6a, 0x75, 0x6d, 0x70, 0x73, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x7c,
+	0x6c, 0x61, 0x7a, 0x79, 0x20, 0x64, 0x6f, 0x67, 0x2e, 0x20, 0x76, 0x0b, 0x63, 0x61, 0x74, 0x93,
+	0x2d, 0x00, 0x15, 0x01, 0x7e, 0x0b, 0x0f, 0xd5, 0x02, 0x00, 0x7a, 0xff, 0x0f, 0x00, 0x00, 0xff,
+	0x0f, 0x00, 0x00, 0x87, 0x0a, 0x00, 0x00, 0x00, 0x40, 0x41, 0x96, 0x27, 0xc4, 0xf9, 0x95, 0xd9,
+	0x9c, 0xbf, 0x0f, 0x0a, 0x31, 0x23, 0xaf, 0x7d, 0xc4, 0xe2, 0xd2, 0xe2, 0xe3, 0xe9, 0x93, 0x50,
+	0x28, 0x2c, 0x75, 0x42, 0xb3, 0x4d, 0xe4, 0xf7, 0xef, 0xee, 0x56, 0xe1, 0xca, 0x31, 0xad, 0x99,
+	0x69, 0xb5, 0x3b, 0x7d, 0x10, 0x1b, 0x7a, 0xde, 0xb4, 0xe3, 0x61, 0x7a, 0x83, 0x28, 0xe0, 0x9f,
+	0x4b, 0x85, 0xfa, 0x28, 0x87, 0x38, 0x75, 0x49, 0x8f, 0x7f, 0x92, 0x17, 0x00, 0x7a, 0x79, 0x20,
+	0x66, 0x6f, 0x78, 0x2e, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+const unsigned char goldenStreamVersion3[] =
+{
+	0x0b, 0x00, 0x04, 0xad, 0x00, 0x03, 0x10, 0xef, 0x03, 0x00, 0x00, 0x00, 0x80, 0x00, 0x20, 0x54,
+	0x68, 0x65, 0x20, 0x71, 0x75, 0x69, 0x63, 0x6b, 0x20, 0x62, 0x72, 0x6f, 0x77, 0x6e, 0x20, 0x66,
+	0x6f, 0x78, 0x20, 0x6a, 0x75, 0x6d, 0x70, 0x73, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x7c,
+	0x6c, 0x61, 0x7a, 0x79, 0x20, 0x64, 0x6f, 0x67, 0x2e, 0x20, 0x76, 0x0b, 0x63, 0x61, 0x74, 0x93,
+	0x00, 0x00, 0x15, 0x01, 0x7e, 0x0b, 0x0f, 0xd5, 0x02, 0x00, 0x7a, 0xff, 0x0f, 0x00, 0x00, 0xff,
+	0x07, 0x00, 0x00, 0x87, 0x02, 0x00, 0x00, 0x00, 0x40, 0x41, 0x96, 0x27, 0xc4, 0xf9, 0x95, 0xd9,
+	0x9c, 0xbf, 0x0f, 0x0a, 0x31, 0x23, 0xaf, 0x7d, 0xc4, 0xe2, 0xd2, 0xe2, 0xe3, 0xe9, 0x93, 0x50,
+	0x28, 0x2c, 0x75, 0x42, 0xb3, 0x4d, 0xe4, 0xf7, 0xef, 0xee, 0x56, 0xe1, 0xca, 0x31, 0xad, 0x99,
+	0x69, 0xb5, 0x3b, 0x7d, 0x10, 0x1b, 0x7a, 0xde, 0xb4, 0xe3, 0x61, 0x7a, 0x83, 0x28, 0xe0, 0x9f,
+	0x4b, 0x85, 0xfa, 0x28, 0x87, 0x38, 0x75, 0x49, 0x8f, 0x7f, 0x92, 0x17, 0x00, 0x7a, 0x79, 0x20,
+	0x66, 0x6f, 0x78, 0x2e, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+const unsigned char goldenStreamVersion4[] =
+{
+	0x0c, 0x00, 0x04, 0xa7, 0x00, 0x03, 0x10, 0xef, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x20, 0x54,
+	0x68, 0x65, 0x20, 0x71, 0x75, 0x69, 0x63, 0x6b, 0x20, 0x62, 0x72, 0x6f, 0x77, 0x6e, 0x20, 0x66,
+	0x6f, 0x78, 0x20, 0x6a, 0x75, 0x6d, 0x70, 0x73, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x7c,
+	0x6c, 0x61, 0x7a, 0x79, 0x20, 0x64, 0x6f, 0x67, 0x2e, 0x20, 0x76, 0x0b, 0x63, 0x61, 0x74, 0x93,
+	0x00, 0x00, 0x15, 0x01, 0x7e, 0x0b, 0x0f, 0xd5, 0x02, 0x00, 0x7a, 0xff, 0x0f, 0x00, 0x00, 0xd5,
+	0x02, 0x00, 0x40, 0x41, 0x96, 0x27, 0xc4, 0xf9, 0x95, 0xd9, 0x9c, 0xbf, 0x0f, 0x0a, 0x31, 0x23,
+	0xaf, 0x7d, 0xc4, 0xe2, 0xd2, 0xe2, 0xe3, 0xe9, 0x93, 0x50, 0x28, 0x2c, 0x75, 0x42, 0xb3, 0x4d,
+	0xe4, 0xf7, 0xef, 0xee, 0x56, 0xe1, 0xca, 0x31, 0xad, 0x99, 0x69, 0xb5, 0x3b, 0x7d, 0x10, 0x1b,
+	0x7a, 0xde, 0xb4, 0xe3, 0x61, 0x7a, 0x83, 0x28, 0xe0, 0x9f, 0x4b, 0x85, 0xfa, 0x28, 0x87, 0x38,
+	0x75, 0x49, 0x8f, 0x7f, 0x92, 0x17, 0x00, 0x7a, 0x79, 0x20, 0x66, 0x6f, 0x78, 0x2e, 0x20, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+const unsigned char* const goldenStreams[] = {goldenStreamVersion0, goldenStreamVersion1, goldenStreamVersion2, goldenStreamVersion3, goldenStreamVersion4};
+const size_t goldenStreamSizes[] = {sizeof(goldenStreamVersion0), sizeof(goldenStreamVersion1), sizeof(goldenStreamVersion2), sizeof(goldenStreamVersion3), sizeof(goldenStreamVersion4)};
+const int GOLDEN_STREAM_COUNT = sizeof(goldenStreams) / sizeof(goldenStreams[0]);
+
+// The payload of the golden streams: repeated text, a long run and a pseudo-random section
+void generateGoldenPayload(vector<char>& payload)
+{
+	const char* text = "The quick brown fox jumps over the lazy dog. The quick brown cat jumps over the lazy fox. ";
+	size_t textLength = strlen(text);
+	for (int i = 0; i < 3; ++i)
+	{
+		payload.insert(payload.end(), text, text + textLength);
+	}
+
+	payload.insert(payload.end(), 600, 'z');
+
+	uint32_t state = 1;
+	for (int i = 0; i < 64; ++i)
+	{
+		state = state * 1103515245 + 12345;
+		payload.push_back(static_cast<char>(state >> 24));
+	}
+
+	payload.insert(payload.end(), text, text + textLength);
+}
+
+// Decodes data compressed with earlier format versions
+bool compatibilityTest()
+{
+	cout << "Format compatibility test" << endl;
+
+	vector<char> payload;
+	generateGoldenPayload(payload);
+	vector<char> decompressed(payload.size());
+
+	doboz::Decompressor decompressor;
+	for (int i = 0; i < GOLDEN_STREAM_COUNT; ++i)
+	{
+		doboz::CompressionInfo compressionInfo;
+		doboz::Result result = decompressor.getCompressionInfo(goldenStreams[i], goldenStreamSizes[i], compressionInfo);
+		if (result != doboz::RESULT_OK || compressionInfo.version != i || compressionInfo.uncompressedSize != payload.size())
+		{
+			cout << "Version " << i << " header FAILED" << endl;
+			return false;
+		}
+
+		result = decompressor.decompress(goldenStreams[i], goldenStreamSizes[i], &decompressed[0], decompressed.size());
+		if (result != doboz::RESULT_OK || decompressed != payload)
+		{
+			cout << "Version " << i << " decoding FAILED" << endl;
+			return false;
+		}
+	}
+
+	cout << "Decoding of versions 0-" << (GOLDEN_STREAM_COUNT - 1) << " successful" << endl;
+	return true;
+}
+
 int main(int argc, char* argv[])
 {
 	cout << "Doboz Data Compression Library - TEST" << endl;
@@ -275,6 +818,26 @@ int main(int argc, char* argv[])
 	// Incremental input size test
 	cout << "3. ";
 	allOk = allOk && incrementalTest();
+	cout << endl;
+
+	// Compression parameter test
+	cout << "4. ";
+	allOk = allOk && parameterTest();
+	cout << endl;
+
+	// Sequence test
+	cout << "5. ";
+	allOk = allOk && sequenceTest();
+	cout << endl;
+
+	// Batch test
+	cout << "6. ";
+	allOk = allOk && batchTest();
+	cout << endl;
+
+	// Format compatibility test
+	cout << "7. ";
+	allOk = allOk && compatibilityTest();
 
 	cleanup();
 